@@ -0,0 +1,49 @@
+#include "benchutil.h"
+#include "utils/ahocorasick.h"
+#include "utils/compiledahocorasick.h"
+
+#include <cstdio>
+
+/*
+Search time of the mutable AhoCorasick trie against the compiled automaton,
+Sparse and Dfa, on dictionaries of growing size. The text is prose in which
+about one word in fifty is from the dictionary.
+
+usage: automatonbench [text length in QChars, default 1000000]
+*/
+int main(int argc, char* argv[]) {
+    qsizetype units = bench::argument(argc, argv, 1, 1000000);
+
+    std::printf("%8s %9s %10s %10s %10s %10s %12s\n",
+                "words", "matches", "trie ms", "sparse ms", "dfa ms", "trie KiB", "compiled KiB");
+    for (int count : {1000, 10000, 50000, 200000}) {
+        std::mt19937 rng(bench::seed);
+        QStringList words = bench::randomWords(count, rng);
+        QString text = bench::randomText(units, words, 0.02, rng);
+
+        AhoCorasick trie;
+        for (int i = 0; i < count; ++i) {
+            trie.insert(words[i], i);
+        }
+        trie.buildFailureLinks();
+        CompiledAhoCorasick sparse(trie, CompiledAhoCorasick::Mode::Sparse);
+        CompiledAhoCorasick dfa(trie, CompiledAhoCorasick::Mode::Dfa);
+
+        size_t trieMatches = 0;
+        size_t sparseMatches = 0;
+        size_t dfaMatches = 0;
+        double trieMs = bench::bestMs(5, [&] { trieMatches = trie.search(text).size(); });
+        double sparseMs = bench::bestMs(5, [&] { sparseMatches = sparse.search(text).size(); });
+        double dfaMs = bench::bestMs(5, [&] { dfaMatches = dfa.search(text).size(); });
+        if (trieMatches != sparseMatches || trieMatches != dfaMatches) {
+            std::fprintf(stderr, "match counts differ: %zu %zu %zu\n", trieMatches, sparseMatches, dfaMatches);
+            return 1;
+        }
+
+        std::printf("%8d %9zu %10.2f %10.2f %10.2f %10zu %12zu%s\n",
+                    count, trieMatches, trieMs, sparseMs, dfaMs,
+                    trie.bytesUsed() / 1024, dfa.bytesUsed() / 1024,
+                    dfa.mode() == CompiledAhoCorasick::Mode::Dfa ? "" : " (dfa too big, sparse)");
+    }
+    return 0;
+}
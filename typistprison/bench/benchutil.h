@@ -0,0 +1,127 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <QString>
+#include <QStringList>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/*
+Helpers shared by the benchmarks. Every input is generated from `seed`, so
+two runs, on any machine, measure the same words and the same text.
+*/
+namespace bench {
+
+const unsigned int seed = 20241017;
+
+// Best of `repeats` runs of `work`, in milliseconds
+template <typename Work>
+double bestMs(int repeats, Work&& work) {
+    double best = 0;
+    for (int i = 0; i < repeats; ++i) {
+        auto begin = std::chrono::steady_clock::now();
+        work();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        best = i == 0 ? ms : std::min(best, ms);
+    }
+    return best;
+}
+
+// Highest resident set size of the process so far, in KiB
+inline long long peakRssKiB() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return -1;
+    }
+    return static_cast<long long>(counters.PeakWorkingSetSize / 1024);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// Command line argument `index` as a number, `fallback` if it is missing
+inline long long argument(int argc, char* argv[], int index, long long fallback) {
+    return argc > index ? std::atoll(argv[index]) : fallback;
+}
+
+// Lowercase latin word of `minLength` to `maxLength` letters
+inline QString randomWord(std::mt19937& rng, int minLength, int maxLength) {
+    std::uniform_int_distribution<int> length(minLength, maxLength);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    QString word;
+    for (int n = length(rng); n > 0; --n) {
+        word += QChar(static_cast<char16_t>(letter(rng)));
+    }
+    return word;
+}
+
+// `count` dictionary words, every eighth one in CJK as in a mixed list
+inline QStringList randomWords(int count, std::mt19937& rng) {
+    std::uniform_int_distribution<int> han(0x4e00, 0x9fa5);
+    QStringList words;
+    for (int i = 0; i < count; ++i) {
+        if (i % 8 == 7) {
+            QString word;
+            for (int n = 2 + i % 3; n > 0; --n) {
+                word += QChar(static_cast<char16_t>(han(rng)));
+            }
+            words.append(word);
+        } else {
+            words.append(randomWord(rng, 4, 12));
+        }
+    }
+    return words;
+}
+
+/*
+Prose of about `units` QChars: space separated filler words with a word of
+`words` in place of the filler one time in 1 / `matchRate`, lines of about
+80 units and a blank line every few paragraphs.
+*/
+inline QString randomText(qsizetype units, const QStringList& words, double matchRate, std::mt19937& rng) {
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    std::uniform_int_distribution<int> pick(0, std::max(0, static_cast<int>(words.size()) - 1));
+    QString text;
+    text.reserve(units + 16);
+    qsizetype lineStart = 0;
+    int lines = 0;
+    while (text.size() < units) {
+        if (!words.isEmpty() && chance(rng) < matchRate) {
+            text += words[pick(rng)];
+        } else {
+            text += randomWord(rng, 1, 9);
+        }
+        if (text.size() - lineStart < 80) {
+            text += QChar(u' ');
+            continue;
+        }
+        text += QChar(u'\n');
+        if (++lines % 6 == 0) {
+            text += QChar(u'\n');
+        }
+        lineStart = text.size();
+    }
+    return text;
+}
+
+}
+
+#endif // BENCHUTIL_H
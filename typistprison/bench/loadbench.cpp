@@ -0,0 +1,114 @@
+#include "benchutil.h"
+#include "fictiontextedit.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QApplication>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextEdit>
+#include <cstdio>
+
+namespace {
+// FictionTextEdit::pagedModeUnits, from here on load() cuts the text into segments
+const qsizetype pagedModeUnits = 1024 * 1024;
+
+/*
+Loading the way FictionTextEdit::load() used to: split the text into lines
+and per line insertBlock(), insertText(), then set the block format and
+merge the char format over the block, so every paragraph is four edits.
+*/
+void loadPerLine(QTextEdit& edit, const QString& text) {
+    QTextBlockFormat blockFormat;
+    blockFormat.setBottomMargin(32);
+    blockFormat.setLeftMargin(16);
+    blockFormat.setRightMargin(16);
+    QTextCharFormat charFormat;
+    charFormat.setFontPointSize(14);
+
+    QTextCursor cursor = edit.textCursor();
+    const QStringList lines = text.split(QLatin1Char('\n'));
+    for (int i = 0; i < lines.size(); ++i) {
+        if (i > 0) {
+            cursor.insertBlock();
+        }
+        cursor.insertText(lines[i]);
+
+        QTextCursor blockCursor(cursor.block());
+        blockCursor.setBlockFormat(blockFormat);
+        blockCursor.select(QTextCursor::BlockUnderCursor);
+        blockCursor.mergeCharFormat(charFormat);
+        cursor.movePosition(QTextCursor::EndOfBlock);
+    }
+}
+
+// Wait until the edit has laid out and painted what load() put in
+void settle(QTextEdit& edit) {
+    edit.document()->documentLayout()->documentSize();
+    QApplication::processEvents();
+}
+}
+
+/*
+Time to open a manuscript in FictionTextEdit: load() and the first layout
+and paint, on generated prose of a tenth, a quarter, half and all of the
+given length, and four times it. Texts of pagedModeUnits or more open in
+paged mode, only a window of segments goes into the document.
+
+Below paged mode the old per line loader is timed too, once per size.
+
+No project is loaded, so nothing is masked or highlighted as wiki text.
+Runs on the offscreen platform unless QT_QPA_PLATFORM says otherwise.
+
+usage: loadbench [text length in QChars, default 1000000]
+*/
+int main(int argc, char* argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+    qsizetype units = bench::argument(argc, argv, 1, 1000000);
+
+    std::mt19937 rng(bench::seed);
+    QStringList words = bench::randomWords(5000, rng);
+    QString full = bench::randomText(4 * units, words, 0.1, rng);
+
+    FictionTextEdit edit(nullptr, nullptr, nullptr);
+    edit.resize(1200, 900);
+    edit.show();
+    QTextEdit perLineEdit;
+    perLineEdit.resize(1200, 900);
+    perLineEdit.show();
+
+    std::printf("%-12s %9s %14s %14s\n", "QChars", "lines", "load() ms", "per line ms");
+    for (qsizetype size : {units / 10, units / 4, units / 2, units, 4 * units}) {
+        QString text = full.left(size);
+        qsizetype lines = text.count(QLatin1Char('\n')) + 1;
+
+        // best of three, each time into an empty editor as when a file is opened
+        double loadMs = 0;
+        for (int i = 0; i < 3; ++i) {
+            edit.load(QString());
+            settle(edit);
+            double ms = bench::bestMs(1, [&] {
+                edit.load(text);
+                settle(edit);
+            });
+            loadMs = i == 0 ? ms : std::min(loadMs, ms);
+        }
+
+        if (size >= pagedModeUnits) {
+            std::printf("%-12lld %9lld %14.2f %14s\n", static_cast<long long>(size),
+                        static_cast<long long>(lines), loadMs, "(paged)");
+            continue;
+        }
+        perLineEdit.clear();
+        settle(perLineEdit);
+        double perLineMs = bench::bestMs(1, [&] {
+            loadPerLine(perLineEdit, text);
+            settle(perLineEdit);
+        });
+        std::printf("%-12lld %9lld %14.2f %14.2f\n", static_cast<long long>(size),
+                    static_cast<long long>(lines), loadMs, perLineMs);
+    }
+    return 0;
+}
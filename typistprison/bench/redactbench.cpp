@@ -0,0 +1,74 @@
+#include "benchutil.h"
+#include "utils/ahocorasick.h"
+#include "utils/compiledahocorasick.h"
+
+#include <cstdio>
+
+namespace {
+/*
+Masking the way matchBannedWords() used to: remove each match and insert
+the asterisks in its place, one match at a time, so every match moves the
+rest of the text twice.
+*/
+QString redactPerMatch(const CompiledAhoCorasick& automaton, const QString& text) {
+    QString result = text;
+    for (const auto& match : automaton.search(QStringView(text))) {
+        int length = automaton.patternLength(match.first);
+        int start = match.second - length + 1;
+        result.remove(start, length);
+        result.insert(start, QString(length, QChar(u'*')));
+    }
+    return result;
+}
+
+void run(const char* name, const QStringList& words, const QString& text) {
+    AhoCorasick trie;
+    for (int i = 0; i < words.size(); ++i) {
+        trie.insert(words[i], i);
+    }
+    trie.buildFailureLinks();
+    CompiledAhoCorasick automaton(trie, CompiledAhoCorasick::Mode::Dfa);
+
+    size_t matches = automaton.search(QStringView(text)).size();
+    QString perMatch;
+    QString singlePass;
+    double perMatchMs = bench::bestMs(1, [&] { perMatch = redactPerMatch(automaton, text); });
+    double singlePassMs = bench::bestMs(5, [&] { singlePass = automaton.redact(text); });
+    std::printf("%-22s %9zu %14.2f %14.2f%s\n", name, matches, perMatchMs, singlePassMs,
+                perMatch == singlePass ? "" : "  (outputs differ!)");
+}
+}
+
+/*
+redact() against masking one match at a time, on texts where matches are
+dense and overlap:
+
+- nested: the words a, aa, ... up to 8 or 64 a's over a text of only a's, so
+  every position ends as many matches as there are words
+- prose: generated prose where half the words are from a 5000 word list
+
+usage: redactbench [text length in QChars, default 20000]
+
+Masking per match grows with text length times matches, keep the text short.
+*/
+int main(int argc, char* argv[]) {
+    qsizetype units = bench::argument(argc, argv, 1, 20000);
+
+    std::printf("%-22s %9s %14s %14s\n", "input", "matches", "per match ms", "redact() ms");
+    for (int longest : {8, 64}) {
+        QStringList words;
+        QString word;
+        for (int i = 0; i < longest; ++i) {
+            word += QChar(u'a');
+            words.append(word);
+        }
+        char name[32];
+        std::snprintf(name, sizeof(name), "nested, %d words", longest);
+        run(name, words, QString(units, QChar(u'a')));
+    }
+
+    std::mt19937 rng(bench::seed);
+    QStringList words = bench::randomWords(5000, rng);
+    run("prose, half matches", words, bench::randomText(units, words, 0.5, rng));
+    return 0;
+}
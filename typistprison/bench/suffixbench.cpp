@@ -0,0 +1,59 @@
+#include "benchutil.h"
+#include "utils/ahocorasick.h"
+#include "utils/compiledahocorasick.h"
+
+#include <cstdio>
+
+/*
+Build time and memory for a word list where most words are suffixes of
+other words, like variants of one word with different prefixes.
+
+The list is `chains` chains of `length` words. A chain starts at one of a
+few common endings and every next word puts one more letter in front of
+the previous one, so each word has all earlier words of its chain as
+suffixes. That is the worst case for copying outputs along failure links,
+which grows with length² per chain, while output links stay linear.
+
+Peak RSS is per process, so run one list size per invocation.
+
+usage: suffixbench [chains, default 200] [words per chain, default 100]
+*/
+int main(int argc, char* argv[]) {
+    int chains = static_cast<int>(bench::argument(argc, argv, 1, 200));
+    int length = static_cast<int>(bench::argument(argc, argv, 2, 100));
+    const char* endings[] = {"ing", "ers", "ness", "ish", "ed"};
+
+    std::mt19937 rng(bench::seed);
+    QStringList words;
+    for (int chain = 0; chain < chains; ++chain) {
+        QString word = QString::fromLatin1(endings[chain % 5]);
+        for (int k = 0; k < length; ++k) {
+            word = bench::randomWord(rng, 1, 1) + word;
+            words.append(word);
+        }
+    }
+    QString text = bench::randomText(1000000, words, 0.02, rng);
+    long long inputKiB = bench::peakRssKiB();
+
+    AhoCorasick trie;
+    CompiledAhoCorasick compiled;
+    double buildMs = bench::bestMs(1, [&] {
+        for (int i = 0; i < words.size(); ++i) {
+            trie.insert(words[i], i);
+        }
+        trie.buildFailureLinks();
+        compiled = CompiledAhoCorasick(trie, CompiledAhoCorasick::Mode::Sparse);
+    });
+    long long builtKiB = bench::peakRssKiB();
+
+    size_t matches = 0;
+    double searchMs = bench::bestMs(5, [&] { matches = compiled.search(text).size(); });
+
+    std::printf("words            %lld\n", static_cast<long long>(words.size()));
+    std::printf("build ms         %.2f (insert, failure links, compile)\n", buildMs);
+    std::printf("trie KiB         %zu\n", trie.bytesUsed() / 1024);
+    std::printf("compiled KiB     %zu\n", compiled.bytesUsed() / 1024);
+    std::printf("peak RSS KiB     %lld (%lld before building)\n", builtKiB, inputKiB);
+    std::printf("search ms        %.2f for %zu matches in 1M QChars\n", searchMs, matches);
+    return 0;
+}
@@ -2,6 +2,32 @@
 #include "utils/contextmenuutil.h"
 #include <QSet>
 
+namespace {
+/*
+Grow the range start..end by one change of the document: `charsRemoved`
+characters at `position` were replaced by `charsAdded` new ones. The range
+is moved along with the text behind the change, anything inside the
+removed part collapses onto the change. start is -1 for an empty range.
+*/
+void growChangedRange(int &start, int &end, int position, int charsRemoved, int charsAdded) {
+    int shift = charsAdded - charsRemoved;
+    int changeEnd = position + charsAdded;
+    if (start < 0) {
+        start = position;
+        end = changeEnd;
+        return;
+    }
+    auto map = [&](int index, int inside) {
+        if (index >= position + charsRemoved) {
+            return index + shift;
+        }
+        return index > position ? inside : index;
+    };
+    start = std::min(map(start, position), position);
+    end = std::max(map(end, changeEnd), changeEnd);
+}
+}
+
 FictionTextEdit::FictionTextEdit(QWidget *parent,
                                  ProjectManager *projectManager,
                                  PrisonerManager *prisonerManager)
@@ -9,10 +35,23 @@ FictionTextEdit::FictionTextEdit(QWidget *parent,
     , globalFontSize(14)
     , matchStringIndex(-1)
     , projectManager(projectManager)
-    , previousDocumentLength(0)
-    , previousCursorPosition(0)
-    , previousDocumentText("")
+    , changedStart(-1)
+    , changedEnd(-1)
+    , ignoreContentsChange(false)
+    , redactionStart(0)
+    , redactionEnd(0)
+    , redactionEditStart(-1)
+    , redactionEditEnd(-1)
+    , redactionPending(false)
+    , windowFirst(0)
+    , windowLast(0)
+    , segmentWindowDirty(false)
+    , recordPagedEdits(true)
+    , topMargin(0)
+    , bottomMargin(0)
     , isInit(true)
+    , wikiGeneration(0)
+    , wikiLayoutGeneration(0)
     , scrollAnimation(nullptr)
 {
     QPalette palette = this->palette();
@@ -22,6 +61,7 @@ FictionTextEdit::FictionTextEdit(QWidget *parent,
 
     setUndoRedoEnabled(false); // forbid undo
                                // do our settings
+    bottomMargin = document()->rootFrame()->frameFormat().bottomMargin();
     setTopMargin(256);         // set top margin as 256
 
     isSniperMode = false;      // default not sniperMode
@@ -47,9 +87,31 @@ FictionTextEdit::FictionTextEdit(QWidget *parent,
 
     highlighter = new FictionHighlighter(this->document());
 
+    // Words of warn and highlight lists are only marked, not masked
+    if (projectManager) {
+        highlighter->setFlaggedSpanFinder([projectManager](QStringView text) {
+            std::vector<FlaggedSpan> spans;
+            for (const BannedWordHit& hit : projectManager->findFlaggedWords(text)) {
+                spans.push_back({hit.start, hit.length, hit.policy == BannedWordsPolicy::Warn});
+            }
+            return spans;
+        });
+        connect(projectManager, &ProjectManager::bannedWordsChanged, highlighter, &FictionHighlighter::rehighlight);
+    }
+
     connect(this, &QTextEdit::textChanged, this, &FictionTextEdit::onTextChanged);
+    connect(document(), &QTextDocument::contentsChange, this, &FictionTextEdit::trackChangedRange);
+    connect(document(), &QTextDocument::contentsChange, this, &FictionTextEdit::recordPagedEdit);
     connect(this, &QTextEdit::cursorPositionChanged, this, &FictionTextEdit::updateCursorPosition);
 
+    // Wiki spans are kept per paragraph, see readBlock()
+    connect(document(), &QTextDocument::contentsChange, this, &FictionTextEdit::invalidateWikiSpans);
+    connect(document()->documentLayout(), &QAbstractTextDocumentLayout::documentSizeChanged,
+            this, [this]() { ++wikiLayoutGeneration; });
+    if (projectManager) {
+        connect(projectManager, &ProjectManager::wikiChanged, this, [this]() { ++wikiGeneration; });
+    }
+
     // image popup
     setMouseTracking(true);
     timer = new QTimer(this);
@@ -60,6 +122,26 @@ FictionTextEdit::FictionTextEdit(QWidget *parent,
     refreshTimer->setSingleShot(true);
     refreshTimer->setInterval(300); // 300ms delay
     connect(refreshTimer, &QTimer::timeout, this, &FictionTextEdit::refresh);
+
+    // paged mode: swap segments in and out while scrolling, at most every 50ms
+    segmentWindowTimer = new QTimer(this);
+    segmentWindowTimer->setSingleShot(true);
+    segmentWindowTimer->setInterval(50);
+    connect(segmentWindowTimer, &QTimer::timeout, this, &FictionTextEdit::updateSegmentWindow);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this]() {
+        if (segments && !segmentWindowTimer->isActive()) {
+            segmentWindowTimer->start();
+        }
+    });
+
+    redactionWatcher = new QFutureWatcher<std::vector<std::pair<int, int>>>(this);
+    connect(redactionWatcher, &QFutureWatcher<std::vector<std::pair<int, int>>>::finished,
+            this, &FictionTextEdit::onRedactionFinished);
+    redactionProgressTimer = new QTimer(this);
+    redactionProgressTimer->setInterval(100);
+    connect(redactionProgressTimer, &QTimer::timeout, this, [this]() {
+        emit redactionProgress(static_cast<int>(redactionDone->load() * 100 / std::max<qsizetype>(redactionText.size(), 1)));
+    });
     
     // Initialize threading support for block computation
     blockSearchWatcher = new QFutureWatcher<int>(this);
@@ -76,27 +158,79 @@ FictionTextEdit::FictionTextEdit(QWidget *parent,
 
 }
 
+FictionTextEdit::~FictionTextEdit()
+{
+    // a running redaction job only holds its own snapshot, let it stop early
+    if (redactionCancel) {
+        redactionCancel->store(true);
+    }
+}
+
 void FictionTextEdit::onTextChanged()
 {
+    // refresh() masking words, nothing new to filter
+    if (ignoreContentsChange) {
+        return;
+    }
     refreshTimer->start();
 }
 
 void FictionTextEdit::setTopMargin(int margin)
 {
-    qDebug() << "FictionTextEdit::setTopMargin";
+    topMargin = margin;
+    applyRootMargins();
+}
+
+void FictionTextEdit::setBottomMargin(int margin)
+{
+    bottomMargin = margin;
+    applyRootMargins();
+}
+
+/*
+Set the root frame's top and bottom margins: the ones asked for, plus in
+paged mode the (estimated) heights of the segments above and below the
+window, so the scroll bar covers the whole manuscript.
+*/
+void FictionTextEdit::applyRootMargins()
+{
     QTextDocument *doc = this->document();
     QTextFrame *rootFrame = doc->rootFrame();
 
+    qreal above = 0;
+    qreal below = 0;
+    if (segments) {
+        above = segments->heightBefore(windowFirst);
+        below = segments->heightBefore(segments->count()) - segments->heightBefore(windowLast);
+    }
+
     QTextFrameFormat format = rootFrame->frameFormat();
-    format.setTopMargin(margin);
+    // a new frame format lays the whole document out again
+    if (format.topMargin() == topMargin + above && format.bottomMargin() == bottomMargin + below) {
+        return;
+    }
+    format.setTopMargin(topMargin + above);
+    format.setBottomMargin(bottomMargin + below);
+
+    // the text stays the same, nothing for refresh() or the tab to look at
+    const QSignalBlocker blocker(this);
+    ignoreContentsChange = true;
     rootFrame->setFrameFormat(format);
+    ignoreContentsChange = false;
 }
 
-void FictionTextEdit::applyBlockFormatting(QTextBlock &block)
+/*
+The manuscript's title is its first paragraph. In paged mode that is only
+the document's first block while the window starts at the first segment,
+otherwise the first block is body text like any other.
+*/
+bool FictionTextEdit::isTitleBlock(const QTextBlock &block) const
 {
-    qDebug() << "FictionTextEdit::applyBlockFormatting";
-    bool isFirstBlock = block.blockNumber() == 0;
+    return block.blockNumber() == 0 && (!segments || windowFirst == 0);
+}
 
+void FictionTextEdit::applyBlockFormatting(QTextBlock &block)
+{
     // Create a cursor at the start of the block
     QTextCursor cursor(block);
 
@@ -108,18 +242,23 @@ void FictionTextEdit::applyBlockFormatting(QTextBlock &block)
 
     blockFormat.setLeftMargin(16);
     blockFormat.setRightMargin(16);
+
+    // formats only, the text stays the same: nothing for refresh() to look at
+    // (sniper mode does this on every scroll)
+    bool wasIgnoring = ignoreContentsChange;
+    ignoreContentsChange = true;
     cursor.setBlockFormat(blockFormat);
 
     // Set character format
     // Apply the character format to the whole block
     cursor.select(QTextCursor::BlockUnderCursor);
     cursor = applyCharFormatting(cursor);
+    ignoreContentsChange = wasIgnoring;
 }
 
 QTextCursor FictionTextEdit::applyCharFormatting(QTextCursor &cursor, bool insertLargeFont)
 {
-    qDebug() << "FictionTextEdit::applyCharFormatting";
-    bool isFirstBlock = cursor.blockNumber() == 0;
+    bool isFirstBlock = isTitleBlock(cursor.block());
 
     QTextCharFormat charFormat = cursor.charFormat();  // Get current char format
 
@@ -244,13 +383,22 @@ QTextCursor FictionTextEdit::applyCharFormatting4NextBlock(QTextCursor &cursor)
 
 */
 void FictionTextEdit::keyPressEvent(QKeyEvent *event) {
-    qDebug() << "FictionTextEdit::keyPressEvent";
     if (isInit) {
         isInit = false;
         this->document()->clearUndoRedoStacks();
     }
 
     emit keyboardInput();
+    // paged mode keeps its own history, QTextEdit would find nothing to undo
+    if (segments && event->matches(QKeySequence::Undo)) {
+        undo();
+        return;
+    }
+    if (segments && event->matches(QKeySequence::Redo)) {
+        redo();
+        return;
+    }
+
     if (event->modifiers() & Qt::ControlModifier) {
         if (event->key() == Qt::Key_Plus || event->key() == Qt::Key_Equal) {
             changeFontSize(1);
@@ -301,9 +449,66 @@ void FictionTextEdit::keyPressEvent(QKeyEvent *event) {
     }
 }
 
+/*
+Show `text` in the editor.
+
+Manuscripts of pagedModeUnits or more are cut into segments (see
+SegmentedText) and only the few around the viewport are in the document
+at a time, so layout, reformatting and filtering cost what the window
+costs, not the book. Scrolling swaps segments in and out; fullText(),
+countWords() and search() see the whole manuscript. With keepCursorPlace
+the cursor stays at the same place in the manuscript and the viewport as
+near to where it was as the estimated segment heights allow, otherwise the
+manuscript opens at the top. The undo history is the edit's own then, see
+undo().
+*/
 void FictionTextEdit::load(const QString &text, bool keepCursorPlace)
 {
-    qDebug() << "FictionTextEdit::load";
+    if (text.size() >= pagedModeUnits) {
+        // where the cursor and the viewport are now, in the whole manuscript
+        qsizetype cursorPosition = this->textCursor().position();
+        if (segments && windowFirst < windowLast) {
+            cursorPosition += segments->start(windowFirst);
+        }
+        int top = verticalScrollBar()->value();
+
+        // one block per line, as insertText() would make them
+        QString lines = text;
+        lines.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+        lines.replace(QLatin1Char('\r'), QLatin1Char('\n'));
+        segments = std::make_unique<SegmentedText>(lines);
+        // nothing of the old document goes into the new segments
+        windowFirst = 0;
+        windowLast = 0;
+        segmentWindowDirty = false;
+        // the history's positions are in the old text, QTextDocument's is
+        // dropped by every swap
+        pagedUndo.clear();
+        pagedRedo.clear();
+        setUndoRedoEnabled(false);
+        if (keepCursorPlace) {
+            int center = segments->segmentAtHeight(top + viewport()->height() / 2 - topMargin);
+            showSegments(center, top - (topMargin + segments->heightBefore(center)), cursorPosition);
+        } else {
+            showSegments(0, 0);
+        }
+        return;
+    }
+    if (segments) {
+        segments.reset();
+        applyRootMargins();
+        highlighter->setFirstBlockIsTitle(true);
+        pagedUndo.clear();
+        pagedRedo.clear();
+        setUndoRedoEnabled(true);
+    }
+    setDocumentText(text, keepCursorPlace);
+    // the whole document, in the background when it is long (see startRedaction())
+    this->refresh();
+}
+
+void FictionTextEdit::setDocumentText(const QString &text, bool keepCursorPlace)
+{
     // detach the FictionTextEdit::refresh to prevent slow out loading
     if (projectManager) {
     }
@@ -341,31 +546,34 @@ void FictionTextEdit::load(const QString &text, bool keepCursorPlace)
         applyBlockFormatting(newBlock);
 
     } else {
-        // Split the input text by line breaks
-        QStringList lines = text.split("\n");
+        // Build the document in one edit: every paragraph gets the same block and
+        // char format, QTextCursor::insertText() starts a new block in the cursor's
+        // block format at every line break ("\n", "\r\n" or "\r"), so the text
+        // goes in as it is, in one piece. Only the first block (the title) is
+        // formatted on its own afterwards.
+        QTextBlockFormat blockFormat;
+        blockFormat.setTopMargin(0);
+        blockFormat.setBottomMargin(32);
+        blockFormat.setLeftMargin(16);
+        blockFormat.setRightMargin(16);
+
+        QTextCharFormat bodyFormat = charFormat;
+        // in sniper mode the centered block is lit up again below
+        bodyFormat.setForeground(isSniperMode ? QColor("#656565") : QColor(Qt::white));
 
         QTextCursor cursor = this->textCursor();
-        cursor.insertText(lines[0]);
+        cursor.beginEditBlock();
+        cursor.setBlockFormat(blockFormat);
+        cursor.insertText(text, bodyFormat);
 
         // First Block
         QTextBlock firstBlock = document()->firstBlock();
         applyBlockFormatting(firstBlock);
+        cursor.endEditBlock();
 
-        // Iterate through each line
-        for (int i = 1; i < lines.size(); ++i) {
-            // Insert a block for each line
-            cursor.insertBlock();
-            QTextBlock newBlock = cursor.block();
-
-            // Insert the line text
-            cursor.insertText(lines[i]);
-
-            // Apply formatting
-            applyBlockFormatting(newBlock);
-
-            // Move to the end of the block for the next iteration
-            cursor.movePosition(QTextCursor::EndOfBlock);
-        } 
+        if (isSniperMode) {
+            findBlockClosestToCenterAsync();
+        }
 
         if (!keepCursorPlace) {
             cursor.movePosition(QTextCursor::Start);
@@ -376,18 +584,336 @@ void FictionTextEdit::load(const QString &text, bool keepCursorPlace)
         
         this->setTextCursor(cursor);
     }
-    previousDocumentText = this->toPlainText();
+    // filtering is up to the caller, load() scans the whole document and
+    // showSegments() only the segments coming in
 
     // attach the FictionTextEdit::refresh to textchanged() signal
     if (projectManager) {
     }
+}
+
+/*
+Paged mode: put segments center - 1 .. center + 1 into the document and
+scroll so the viewport top is `offset` below the top of `center`. The
+cursor goes to `cursorPosition` (in the whole manuscript) if that is in
+the window, else to the start of `center`.
+
+Segments coming into the window are filtered for banned words then, the
+ones staying were when they came in. Edits not filtered yet (and the
+range of a running redaction job, whose result no longer fits) are
+scanned again at their new place.
+
+Swapping is not an edit: no textChanged and nothing to undo. The undo
+history is kept in positions in the whole manuscript, so it stays valid.
+*/
+void FictionTextEdit::showSegments(int center, qreal offset, qsizetype cursorPosition)
+{
+    const QSignalBlocker blocker(this);
+
+    // what still has to be scanned, as positions in the whole manuscript
+    qsizetype oldStart = windowFirst < windowLast ? segments->start(windowFirst) : 0;
+    qsizetype oldEnd = windowFirst < windowLast ? oldStart + document()->characterCount() - 1 : 0;
+    int pendingStart = changedStart;
+    int pendingEnd = changedEnd;
+    if (redactionWatcher->isRunning()) {
+        pendingStart = pendingStart < 0 ? redactionStart : std::min(pendingStart, redactionStart);
+        pendingEnd = std::max(pendingEnd, redactionEnd);
+    }
 
+    commitSegmentWindow();
+    windowFirst = std::max(center - 1, 0);
+    windowLast = std::min(center + 2, segments->count());
+    highlighter->setFirstBlockIsTitle(windowFirst == 0);
+    recordPagedEdits = false;
+    setDocumentText(segments->joined(windowFirst, windowLast), false);
+    recordPagedEdits = true;
+    windowText = segments->joined(windowFirst, windowLast);
+    segmentWindowDirty = false;
+
+    measureSegmentWindow();
+    applyRootMargins();
+
+    qsizetype windowStart = segments->start(windowFirst);
+    qsizetype windowEnd = segments->start(windowLast - 1) + segments->text(windowLast - 1).size();
+    if (cursorPosition < windowStart || cursorPosition > windowEnd) {
+        cursorPosition = segments->start(center);
+    }
+    QTextCursor cursor = this->textCursor();
+    cursor.setPosition(static_cast<int>(cursorPosition - windowStart));
+    this->setTextCursor(cursor);
+    verticalScrollBar()->setValue(qRound(topMargin + segments->heightBefore(center) + offset));
+
+    // the segments above and below the old window, and the pending edits
+    qsizetype scanStart = windowEnd;
+    qsizetype scanEnd = windowStart;
+    auto include = [&](qsizetype start, qsizetype end) {
+        start = std::max(start, windowStart);
+        end = std::min(end, windowEnd);
+        if (start < end) {
+            scanStart = std::min(scanStart, start);
+            scanEnd = std::max(scanEnd, end);
+        }
+    };
+    if (oldStart >= oldEnd) {
+        include(windowStart, windowEnd);
+    } else {
+        include(windowStart, oldStart);
+        include(oldEnd, windowEnd);
+    }
+    if (pendingStart >= 0) {
+        include(oldStart + pendingStart, oldStart + pendingEnd);
+    }
+    changedStart = scanStart < scanEnd ? static_cast<int>(scanStart - windowStart) : -1;
+    changedEnd = scanStart < scanEnd ? static_cast<int>(scanEnd - windowStart) : -1;
+    refreshTimer->stop();
     this->refresh();
 }
 
+/*
+Undo the last edit. In paged mode from the edit's own history (pagedUndo),
+showing the edit's segment first if it is not in the window.
+*/
+void FictionTextEdit::undo()
+{
+    if (!segments) {
+        QTextEdit::undo();
+        return;
+    }
+    if (pagedUndo.empty()) {
+        return;
+    }
+    PagedEdit edit = pagedUndo.back();
+    pagedUndo.pop_back();
+    replacePagedRange(edit.position, edit.added.size(), edit.removed);
+    pagedRedo.push_back(edit);
+}
+
+void FictionTextEdit::redo()
+{
+    if (!segments) {
+        QTextEdit::redo();
+        return;
+    }
+    if (pagedRedo.empty()) {
+        return;
+    }
+    PagedEdit edit = pagedRedo.back();
+    pagedRedo.pop_back();
+    replacePagedRange(edit.position, edit.removed.size(), edit.added);
+    pagedUndo.push_back(edit);
+}
+
+/*
+Paged mode: keep the document's text (windowText) up to date and record
+every edit the user makes in pagedUndo, with its position in the whole
+manuscript. Typing or deleting one character after the other is one step,
+as in QTextDocument. Format changes remove and add the same text and are
+skipped, masking (ignoreContentsChange) keeps every position where it was
+and is not worth an undo step of its own.
+*/
+void FictionTextEdit::recordPagedEdit(int position, int charsRemoved, int charsAdded)
+{
+    if (!segments) {
+        return;
+    }
+    // a change of the whole document also counts the last paragraph separator
+    int end = std::min(position + charsAdded, document()->characterCount() - 1);
+    QTextCursor cursor(document());
+    cursor.setPosition(position);
+    cursor.setPosition(std::max(end, position), QTextCursor::KeepAnchor);
+    QString added = cursor.selectedText();
+    added.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+    QString removed = windowText.mid(position, charsRemoved);
+    if (removed == added) {
+        return;
+    }
+    windowText.replace(position, removed.size(), added);
+    if (!recordPagedEdits || ignoreContentsChange) {
+        return;
+    }
+
+    qsizetype at = segments->start(windowFirst) + position;
+    pagedRedo.clear();
+    if (!pagedUndo.empty()) {
+        PagedEdit &last = pagedUndo.back();
+        bool typing = removed.isEmpty() && last.removed.isEmpty() && !added.contains(QLatin1Char('\n'));
+        bool deleting = added.isEmpty() && last.added.isEmpty();
+        if (typing && at == last.position + last.added.size()) {
+            last.added += added;
+            return;
+        }
+        if (deleting && at + removed.size() == last.position) {
+            // backspace
+            last.position = at;
+            last.removed.prepend(removed);
+            return;
+        }
+        if (deleting && at == last.position) {
+            // delete
+            last.removed += removed;
+            return;
+        }
+    }
+    pagedUndo.push_back({at, removed, added});
+}
+
+/*
+Paged mode: replace `length` characters at `position`, in the whole
+manuscript, by `text` for undo() and redo(), without recording it. The
+segment is shown first if needed; what does not fit the window (undoing a
+very long paste) is written into the segments directly.
+*/
+void FictionTextEdit::replacePagedRange(qsizetype position, qsizetype length, const QString &text)
+{
+    auto fitsWindow = [&]() {
+        qsizetype windowStart = segments->start(windowFirst);
+        return position >= windowStart && position + length <= windowStart + windowText.size();
+    };
+    if (!fitsWindow()) {
+        showSegments(segments->segmentAt(position), 0, position);
+    }
+    if (!fitsWindow()) {
+        commitSegmentWindow();
+        int first = segments->segmentAt(position);
+        int last = segments->segmentAt(position + length) + 1;
+        QString joined = segments->joined(first, last);
+        joined.replace(position - segments->start(first), length, text);
+        segments->replace(first, last, joined);
+        // the window's segments are gone, all of the new window is new
+        windowFirst = 0;
+        windowLast = 0;
+        showSegments(segments->segmentAt(position), 0, position + text.size());
+        return;
+    }
+
+    qsizetype windowStart = segments->start(windowFirst);
+    QTextCursor cursor(document());
+    cursor.setPosition(static_cast<int>(position - windowStart));
+    cursor.setPosition(static_cast<int>(position - windowStart + length), QTextCursor::KeepAnchor);
+    recordPagedEdits = false;
+    cursor.insertText(text);
+    recordPagedEdits = true;
+    this->setTextCursor(cursor);
+}
+
+/*
+Paged mode: write the document back into the segments it came from, if
+it changed since, and measure them. The window is cut again, so a segment
+that grew while typing is split. Only done when the window is swapped or
+the manuscript saved, not per keystroke.
+*/
+void FictionTextEdit::commitSegmentWindow()
+{
+    if (!segments) {
+        return;
+    }
+    if (segmentWindowDirty) {
+        windowLast = windowFirst + segments->replace(windowFirst, windowLast, this->toPlainText());
+        segmentWindowDirty = false;
+    }
+    measureSegmentWindow();
+    // windowLast may have moved, and the estimates of the hidden segments with the measurements
+    applyRootMargins();
+}
+
+/*
+Paged mode: take the heights of the segments in the window from the
+layout, the first blocks of two segments in a row are one segment apart.
+*/
+void FictionTextEdit::measureSegmentWindow()
+{
+    QAbstractTextDocumentLayout *layout = document()->documentLayout();
+    QTextBlock block = document()->firstBlock();
+    qreal top = layout->blockBoundingRect(block).top();
+    for (int segment = windowFirst; segment < windowLast; ++segment) {
+        int blocks = static_cast<int>(segments->text(segment).count(QLatin1Char('\n'))) + 1;
+        for (int i = 0; i < blocks && block.isValid(); ++i) {
+            block = block.next();
+        }
+        qreal bottom = block.isValid()
+            ? layout->blockBoundingRect(block).top()
+            : layout->documentSize().height() - document()->rootFrame()->frameFormat().bottomMargin();
+        segments->setHeight(segment, bottom - top);
+        top = bottom;
+    }
+}
+
+/*
+Paged mode: once the viewport comes within one screen of the hidden
+segments, write the window back and show the segments around the one
+now in the middle of the viewport, at the same place on screen.
+*/
+void FictionTextEdit::updateSegmentWindow()
+{
+    if (!segments) {
+        return;
+    }
+    int top = verticalScrollBar()->value();
+    int height = viewport()->height();
+    qreal windowTop = topMargin + segments->heightBefore(windowFirst);
+    qreal windowBottom = topMargin + segments->heightBefore(windowLast);
+    bool needAbove = windowFirst > 0 && top - height < windowTop;
+    bool needBelow = windowLast < segments->count() && top + 2 * height > windowBottom;
+    if (!needAbove && !needBelow) {
+        return;
+    }
+
+    qsizetype cursorPosition = segments->start(windowFirst) + this->textCursor().position();
+    commitSegmentWindow();
+    int center = segments->segmentAtHeight(top + height / 2 - topMargin);
+    // the window already is as good as it gets, e.g. segments shorter than the viewport
+    if (std::max(center - 1, 0) == windowFirst && std::min(center + 2, segments->count()) == windowLast) {
+        return;
+    }
+    qreal offset = top - (topMargin + segments->heightBefore(center));
+    showSegments(center, offset, cursorPosition);
+}
+
+/*
+Select `length` characters at `start`, a position in the whole manuscript
+in paged mode, showing its segment first if needed.
+*/
+void FictionTextEdit::selectTextRange(qsizetype start, qsizetype length)
+{
+    if (segments) {
+        int segment = segments->segmentAt(start);
+        if (segment < windowFirst || segment >= windowLast) {
+            showSegments(segment, 0, start);
+        }
+        start -= segments->start(windowFirst);
+    }
+    QTextCursor cursor = this->textCursor();
+    cursor.setPosition(static_cast<int>(start));
+    cursor.setPosition(static_cast<int>(start + length), QTextCursor::KeepAnchor);
+    this->setTextCursor(cursor);
+}
+
+QString FictionTextEdit::fullText()
+{
+    if (!segments) {
+        return this->toPlainText();
+    }
+    commitSegmentWindow();
+    return segments->toPlainText();
+}
+
+/*
+Sum of counter(text) over the manuscript. In paged mode the counts of the
+segments not in the window are cached, so `counter` has to stay the same
+function; only the window is counted again, straight from the document.
+*/
+int FictionTextEdit::countWords(const std::function<int(const QString &)> &counter)
+{
+    if (!segments) {
+        return counter(this->toPlainText());
+    }
+    return segments->countWords(counter, 0, windowFirst)
+         + counter(this->toPlainText())
+         + segments->countWords(counter, windowLast, segments->count());
+}
+
 void FictionTextEdit::insertFromMimeData(const QMimeData *source)
 {
-    qDebug() << "FictionTextEdit::insertFromMimeData";
     // Get plain text from the source
     QString plainText = source->text();
 
@@ -401,7 +927,7 @@ void FictionTextEdit::insertFromMimeData(const QMimeData *source)
 
     QTextBlock firstBlock = this->document()->firstBlock();
     QTextBlock currentBlock = cursor.block();
-    if ((cursor.blockNumber() != 0) || (not plainText.contains('\n'))) {
+    if (!isTitleBlock(cursor.block()) || (not plainText.contains('\n'))) {
         // direct insert if not in first block
         cursor.insertText(plainText);
         QTextBlock newBlock = cursor.block();
@@ -423,10 +949,13 @@ void FictionTextEdit::insertFromMimeData(const QMimeData *source)
             }
         }
     }
+
+    // filter the pasted text right away, large pastes go to the background
+    refreshTimer->stop();
+    refresh();
 }
 
 void FictionTextEdit::changeFontSize(int delta) {
-    qDebug() << "FictionTextEdit::changeFontSize";
     // Find the paragraph (block) that's currently in the center
     QTextBlock centerBlock = findBlockClosestToCenter();
 
@@ -450,12 +979,22 @@ void FictionTextEdit::changeFontSize(int delta) {
     format.setFontPointSize(globalFontSize);
 
     // Merge the new format with the existing format to preserve colors
+    // (the text stays the same, nothing for refresh() to look at)
+    ignoreContentsChange = true;
     cursor.mergeCharFormat(format);
+    ignoreContentsChange = false;
 
     // Ensure the first block is formatted correctly
     QTextBlock firstBlock = document()->firstBlock();
     applyBlockFormatting(firstBlock);
 
+    // Paged mode: every segment's height changed, estimate them again from the window
+    if (segments) {
+        segments->clearHeights();
+        measureSegmentWindow();
+        applyRootMargins();
+    }
+
     // Update the text color for the centered block
     if (isSniperMode) {
         updateFocusBlock();
@@ -518,7 +1057,6 @@ returns: QTextBlock
     block closest to the center of the visible area
 */
 QTextBlock FictionTextEdit::findBlockClosestToCenter() {
-    qDebug() << "FictionTextEdit::findBlockClosestToCenter";
     QTextDocument *doc = document();
     int centerY = getVisibleCenterY();
 
@@ -657,7 +1195,6 @@ void FictionTextEdit::findBlockClosestToCenterAsyncThrottled() {
 }
 
 void FictionTextEdit::findBlockClosestToCenterAsyncImpl() {
-    qDebug() << "FictionTextEdit::findBlockClosestToCenterAsyncImpl";
     // Cancel any existing computation to avoid stacking multiple requests
     if (blockSearchWatcher->isRunning()) {
         blockSearchFuture.cancel();
@@ -701,7 +1238,6 @@ void FictionTextEdit::findBlockClosestToCenterAsyncImpl() {
 }
 
 int FictionTextEdit::findBlockClosestToCenterWorker(const DocumentData &data) {
-    qDebug() << "FictionTextEdit::findBlockClosestToCenterWorker";
     if (data.blocks.isEmpty()) {
         return -1;
     }
@@ -834,7 +1370,6 @@ void FictionTextEdit::onBlockSearchComplete() {
 }
 
 void FictionTextEdit::updateFocusBlock() {
-    qDebug() << "FictionTextEdit::updateFocusBlock";
     disconnect(this, &QTextEdit::textChanged, this, &FictionTextEdit::refresh);
 
     int centerY = getVisibleCenterY();
@@ -888,7 +1423,6 @@ void FictionTextEdit::updateFocusBlock() {
 
 void FictionTextEdit::changeGlobalTextColor(const QColor &color)
 {
-    qDebug() << "FictionTextEdit::changeGlobalTextColor";
     // Select the entire document
     QTextCursor cursor(this->document());
     cursor.select(QTextCursor::Document);
@@ -898,7 +1432,10 @@ void FictionTextEdit::changeGlobalTextColor(const QColor &color)
     format.setForeground(color);
 
     // Merge the new format with the existing format to preserve colors
+    // (the text stays the same, nothing for refresh() to look at)
+    ignoreContentsChange = true;
     cursor.mergeCharFormat(format);
+    ignoreContentsChange = false;
 
     // Ensure the centered block is formatted correctly (async)
     if (isSniperMode) {
@@ -949,6 +1486,22 @@ void FictionTextEdit::search(const QString &searchString) {
         matchStringIndex = -1;
     }
 
+    // Paged mode: search every segment, positions are in the whole manuscript
+    if (segments) {
+        commitSegmentWindow();
+        qsizetype found = segments->indexOf(searchString, matchStringIndex + 1, Qt::CaseInsensitive);
+        if (found == -1) {
+            found = segments->indexOf(searchString, 0, Qt::CaseInsensitive);
+            if (found == -1) {
+                return; // No match found
+            }
+        }
+        matchStringIndex = static_cast<int>(found);
+        selectTextRange(found, searchString.length());
+        highlighter->setSearchString(searchString);
+        return;
+    }
+
     QString documentText = this->document()->toPlainText();
 
     // Convert both document text and search string to lower case for case-insensitive comparison
@@ -975,6 +1528,22 @@ void FictionTextEdit::search(const QString &searchString) {
 }
 
 void FictionTextEdit::searchPrev(const QString &searchString) {
+    // Paged mode: search every segment, positions are in the whole manuscript
+    if (segments) {
+        commitSegmentWindow();
+        qsizetype found = segments->lastIndexOf(
+            searchString, matchStringIndex == -1 ? -1 : matchStringIndex - 1, Qt::CaseInsensitive);
+        if (found == -1) {
+            found = segments->lastIndexOf(searchString, -1, Qt::CaseInsensitive);
+            if (found == -1) {
+                return;
+            }
+        }
+        matchStringIndex = static_cast<int>(found);
+        selectTextRange(found, searchString.length());
+        return;
+    }
+
     QString documentText = this->document()->toPlainText();
 
     // Convert both document text and search string to lower case for case-insensitive comparison
@@ -1006,7 +1575,7 @@ void FictionTextEdit::clearSearch() {
     matchStringIndex = -1;
 }
 
-/*  Update cursor position to be used in FictionTextEdit::refresh()
+/*  Keep the cursor block centered in sniper mode
     
     return None
 */
@@ -1020,12 +1589,54 @@ void FictionTextEdit::updateCursorPosition() {
         }
         previousCursorBlock = currentBlock;
     }
-    previousCursorPosition = cursor.position();
+}
+
+/*
+Grow the range refresh() has to look at by one change of the document, as
+reported by QTextDocument::contentsChange: `charsRemoved` characters at
+`position` were replaced by `charsAdded` new ones. The range already
+collected is moved along with the text behind the change. A running
+redaction job's snapshot is followed as well, see applyRedaction().
+
+Format changes are reported the same way, with charsRemoved == charsAdded,
+and Qt reports typing over a selection of the same length identically. So
+format-only changes are recognised where they are made instead: block
+formatting (sniper mode, on every scroll) and whole document ones set
+ignoreContentsChange and return early here, before widening any range.
+*/
+void FictionTextEdit::trackChangedRange(int position, int charsRemoved, int charsAdded) {
+    if (ignoreContentsChange || (charsRemoved == 0 && charsAdded == 0)) {
+        return;
+    }
+    segmentWindowDirty = true;
+    // a running job's snapshot moves with the text in front of it, edits
+    // touching it are remembered, edits behind it do not matter
+    if (redactionWatcher->isRunning()) {
+        if (position + charsRemoved < redactionStart) {
+            int shift = charsAdded - charsRemoved;
+            redactionStart += shift;
+            redactionEnd += shift;
+            if (redactionEditStart >= 0) {
+                redactionEditStart += shift;
+                redactionEditEnd += shift;
+            }
+        } else if (position <= redactionEnd) {
+            growChangedRange(redactionEditStart, redactionEditEnd, position, charsRemoved, charsAdded);
+            growChangedRange(redactionStart, redactionEnd, position, charsRemoved, charsAdded);
+        }
+    }
+    growChangedRange(changedStart, changedEnd, position, charsRemoved, charsAdded);
 }
 
 /*
 refresh() used to filter banned words when user input;
 
+Only the text changed since the last call is scanned, widened by the
+longest banned word on both sides so words crossing its edges are found
+too. The cost of a keystroke does not depend on the document length.
+Ranges of backgroundRedactionUnits or more (paste, load) are scanned by a
+background job instead, see startRedaction().
+
 ┌────────┐
 │        │
 │        │
@@ -1033,107 +1644,194 @@ refresh() used to filter banned words when user input;
 └────────┘
 */
 void FictionTextEdit::refresh() {
-    qDebug() << "FictionTextEdit::refresh";
-    if (projectManager) {
-        if (projectManager->isLoadedProject) {
-            QString currentDocumentText = this->toPlainText();
-            // if no text changes is loaded into document
-            if (currentDocumentText == previousDocumentText) {
-                return;
-            }
+    // the job keeps the range, retried when it is done
+    if (redactionWatcher->isRunning()) {
+        redactionPending = true;
+        return;
+    }
 
-            // get cursor position and scroll value
-            QTextCursor cursor = this->textCursor();
-            int currentCursorPosition = cursor.position();
-            // int currentScrollValue = verticalScrollBar()->value();
+    int startIndex = changedStart;
+    int endIndex = changedEnd;
 
-            // get current document length and compare with previous length;
-            int currentDocumentLength = this->document()->characterCount() - 1;
+    // if no text changes since the last refresh
+    if (!projectManager || !projectManager->isLoadedProject || startIndex < 0) {
+        changedStart = -1;
+        changedEnd = -1;
+        return;
+    }
 
-            int startIndex;
-            int endIndex;
-            int maxiumBannedWordLength = projectManager->getMaxiumBannedWordLength();
+    int maxiumBannedWordLength = projectManager->getMaxiumBannedWordLength();
 
-            // identify the the type of text change
-            int lengthDifference = currentDocumentLength - previousDocumentLength;
-            int minCursorIndex = std::min(currentCursorPosition, previousCursorPosition);
-            int maxCursorIndex = std::max(currentCursorPosition, previousCursorPosition);
+    // make start and end index wthin range of the document
+    int currentDocumentLength = this->document()->characterCount() - 1;
+    startIndex = std::max(startIndex - maxiumBannedWordLength, 0);
+    endIndex = std::min(endIndex + maxiumBannedWordLength, currentDocumentLength);
+    if (maxiumBannedWordLength == 0 || startIndex >= endIndex) {
+        changedStart = -1;
+        changedEnd = -1;
+        return;
+    }
 
-            if ( (currentDocumentText.mid(0, minCursorIndex - 1) == previousDocumentText.mid(0, minCursorIndex - 1))
-                 &
-                 (currentDocumentText.mid(currentCursorPosition) == previousDocumentText.mid(previousCursorPosition)) ) {
-                // If insertion or removal
-                // keyboard input; keyboard deletion; keyboard pasting; select and deletion; 
+    if (endIndex - startIndex >= backgroundRedactionUnits) {
+        startRedaction(startIndex, endIndex);
+        return;
+    }
+    changedStart = -1;
+    changedEnd = -1;
+
+    // copy out only the range, paragraph separators do not matter for matching
+    QTextCursor rangeCursor(this->document());
+    rangeCursor.setPosition(startIndex);
+    rangeCursor.setPosition(endIndex, QTextCursor::KeepAnchor);
+    QString subChangedText = rangeCursor.selectedText();
+    applyMaskedRanges(startIndex, subChangedText, projectManager->findMaskedRanges(subChangedText));
+}
 
-                startIndex = currentCursorPosition - lengthDifference - maxiumBannedWordLength;
-                endIndex = currentCursorPosition + maxiumBannedWordLength;
-            } else {
-                // Perform binary search to find the longest prefix that is a substring in both the
-                // previous and current documents.
-                int left = 0;                                   // Minimum length of prefix
-                int right = minCursorIndex;                     // Maximum length of prefix
-                int bestLength = 0;
-
-                while (left <= right) {
-                    int mid = left + (right - left) / 2;        // Midpoint for binary search
-                    QString prefix = currentDocumentText.left(mid);
-
-                    if (previousDocumentText.contains(prefix)) {
-                        bestLength = mid;                       // Update the best length found
-                        left = mid + 1;                         // Try for a longer prefix
-                    } else {
-                        right = mid - 1;                        // Try for a shorter prefix
-                    }
-                }
-                startIndex = bestLength - maxiumBannedWordLength;
-                endIndex = maxCursorIndex + maxiumBannedWordLength; // todo: better update
-            }
+/*
+Scan document positions start..end on the global thread pool.
+
+The job gets a copy of the range and hands back only the ranges to mask,
+the range is its job from now on. Typing goes on meanwhile and is tracked
+as usual; it only spoils the matches it touches, see applyRedaction(), so
+a large paste or file is masked even while the user keeps typing or
+scrolling. Texts of redactionProgressUnits or more report
+redactionProgress().
+*/
+void FictionTextEdit::startRedaction(int start, int end) {
+    QTextCursor rangeCursor(this->document());
+    rangeCursor.setPosition(start);
+    rangeCursor.setPosition(end, QTextCursor::KeepAnchor);
+    redactionText = rangeCursor.selectedText();
+    redactionStart = start;
+    redactionEnd = end;
+    redactionEditStart = -1;
+    redactionEditEnd = -1;
+    changedStart = -1;
+    changedEnd = -1;
+    redactionCancel = std::make_shared<std::atomic<bool>>(false);
+    redactionDone = std::make_shared<std::atomic<qsizetype>>(0);
+
+    if (redactionText.size() >= redactionProgressUnits) {
+        emit redactionProgress(0);
+        redactionProgressTimer->start();
+    }
 
-            // make start and end index wthin range of QString  
-            if (startIndex < 0) {
-                startIndex = 0;                                // Clamp startIndex to 0
-            }
-            if (endIndex >= currentDocumentLength) {
-                endIndex = currentDocumentLength - 1;          // C
-            }
+    // the job must not touch `this` or the manager, either may be gone before
+    // it ends, so it holds on to the build of the banned words it scans with
+    std::shared_ptr<const BannedWords> words = projectManager->currentBannedWords();
+    QString text = redactionText;
+    std::shared_ptr<std::atomic<bool>> cancel = redactionCancel;
+    std::shared_ptr<std::atomic<qsizetype>> done = redactionDone;
+    redactionWatcher->setFuture(QtConcurrent::run([words, text, cancel, done]() {
+        return ProjectManager::findMaskedRanges(words.get(), text, [&](qsizetype units) {
+            done->store(units);
+            return !cancel->load();
+        });
+    }));
+}
 
-            QString subChangedText = currentDocumentText.mid(startIndex, endIndex - startIndex + 1);
-            QString filteredText = projectManager->matchBannedWords(subChangedText);
+void FictionTextEdit::onRedactionFinished() {
+    bool wasReporting = redactionProgressTimer->isActive();
+    redactionProgressTimer->stop();
 
-            for (int index = startIndex; index <= endIndex; ++index) {
-                // Bounds check to prevent crash
-                // Break if we've reached the end of either string to prevent out-of-bounds access
-                if ((index - startIndex) >= subChangedText.length() || (index - startIndex) >= filteredText.length()) {
-                    break;
-                }
-                QChar subChangedChar = subChangedText.at(index - startIndex);
-                QChar filteredChar = filteredText.at(index - startIndex);
+    if (!redactionCancel->load()) {
+        applyRedaction(redactionWatcher->result());
+    }
+    redactionText.clear();
 
-                if (subChangedChar != filteredChar) {
+    if (wasReporting) {
+        emit redactionProgress(100);
+    }
+    // edits made meanwhile still have to be scanned
+    if (redactionPending || changedStart >= 0) {
+        redactionPending = false;
+        refreshTimer->start();
+    }
+}
+
+/*
+Mask the `ranges` a redaction job found in its snapshot.
+
+Edits made while the job ran (redactionEditStart..redactionEditEnd, in
+document positions now) only spoil the part of the snapshot they cover:
+the snapshot in front of them is still at redactionStart, the part behind
+them still ends at redactionEnd. Ranges entirely in one of those parts are
+masked, the ones crossing the edits are left to refresh(), which scans the
+edits again anyway (they are in changedStart..changedEnd) together with
+the longest banned word on both sides.
+*/
+void FictionTextEdit::applyRedaction(const std::vector<std::pair<int, int>> &ranges) {
+    int size = redactionText.size();
+    int frontEnd = size;            // snapshot positions before it are unchanged
+    int backStart = size;           // and from here on
+    int backOffset = redactionStart;
+    if (redactionEditStart >= 0) {
+        frontEnd = redactionEditStart - redactionStart;
+        backStart = size - (redactionEnd - redactionEditEnd);
+        backOffset = redactionEditEnd - backStart;
+    }
 
-                    // Create a QTextCursor for the QTextEdit
-                    QTextCursor cursor = this->textCursor();
-                    // Set the cursor position
-                    cursor.setPosition(index);
-                    // Perform deletion of the character at the cursor
-                    cursor.deleteChar();
-                    // Insert the "*"
-                    cursor.insertText("*");
+    std::vector<std::pair<int, int>> front;
+    std::vector<std::pair<int, int>> back;
+    for (const auto& range : ranges) {
+        if (range.second <= frontEnd) {
+            front.push_back(range);
+        } else if (range.first >= backStart) {
+            back.push_back(range);
+        }
+    }
 
-                }
+    // both parts in one undo step
+    QTextCursor cursor(this->document());
+    cursor.beginEditBlock();
+    applyMaskedRanges(redactionStart, redactionText, front);
+    applyMaskedRanges(backOffset, redactionText, back);
+    cursor.endEditBlock();
+}
+
+/*
+Replace the characters of `ranges` (see ProjectManager::findMaskedRanges())
+in `text`, which starts at document position `offset`, by '*'.
+
+All of it is one edit block: one undo step, one layout pass and one
+textChanged, which is not tracked (see onTextChanged()). Characters that
+already are '*' are left alone, so a range only partly masked before is
+patched where needed.
+*/
+void FictionTextEdit::applyMaskedRanges(int offset, const QString &text,
+                                        const std::vector<std::pair<int, int>> &ranges) {
+    const QChar mask('*');
+    QTextCursor cursor(this->document());
+    bool editing = false;
+    ignoreContentsChange = true;
+    for (const auto& [rangeStart, rangeEnd] : ranges) {
+        for (int index = rangeStart; index < rangeEnd; ++index) {
+            if (text.at(index) == mask) {
+                continue;
+            }
+            int runEnd = index + 1;
+            while (runEnd < rangeEnd && text.at(runEnd) != mask) {
+                ++runEnd;
             }
+            if (!editing) {
+                cursor.beginEditBlock();
+                editing = true;
+            }
+            // replace the whole run at once, in the format of the text it covers
+            cursor.setPosition(offset + index);
+            cursor.setPosition(offset + runEnd, QTextCursor::KeepAnchor);
+            cursor.insertText(QString(runEnd - index, mask));
+            index = runEnd;
         }
     }
-    // to be used in next FictionTextEdit::refresh
-    previousDocumentLength = this->document()->characterCount() - 1;
-    QTextCursor cursor = this->textCursor();
-    previousCursorPosition = cursor.position();
-    previousDocumentText = this->document()->toPlainText();
-    return;
+    if (editing) {
+        cursor.endEditBlock();
+        segmentWindowDirty = true;
+    }
+    ignoreContentsChange = false;
 }
 
 void FictionTextEdit::mouseMoveEvent(QMouseEvent *event) {
-    qDebug() << "FictionTextEdit::mouseMoveEvent";
     lastMousePos = event->pos();
 
     emit hideWiki();
@@ -1146,111 +1844,42 @@ void FictionTextEdit::readBlock() {
     // Get cursor at mouse position
     QTextCursor cursor = cursorForPosition(lastMousePos);
     QTextBlock block = cursor.block();
-    QString blockText = block.text();
 
-    if (blockText.isEmpty() || !projectManager) {
+    if (block.length() <= 1 || !projectManager) {
         return;
     }
-    
-    // Get matches from wikiTrie for the block text
-    QMap<QString, QList<QPair<int, QString>>> matches = projectManager->matchWikiContent(blockText);
-    
-    // Get the block's layout
-    QTextLayout* layout = block.layout();
-    
+
+    WikiBlockData* data = wikiSpansFor(block);
+
+    // The cursor lands before or after the character under the mouse
+    int position = cursor.position() - block.position();
+    std::vector<int> candidates;
+    data->overlapping(position - 1, position + 1, candidates);
+    if (candidates.empty()) {
+        return;
+    }
+
     // Get the block's position in document coordinates
     QPointF blockPos = document()->documentLayout()->blockBoundingRect(block).topLeft();
+    QPointF viewportOffset(horizontalScrollBar()->value(), verticalScrollBar()->value());
     QSet<QString> matchedWikiKeysSet;  // Use QSet to ensure unique keys
 
-    // Iterate through the matches
-    for (const QString& wikiKey : matches.keys()) {
-        qDebug() << "wikiKey: " << wikiKey;
-        qDebug() << "matches[wikiKey]: " << matches[wikiKey];
-        qDebug() << "matches[wikiKey].size(): " << matches[wikiKey].size();
-        qDebug() << "matches[wikiKey][0].first: " << matches[wikiKey][0].first;
-        const QList<QPair<int, QString>>& matchesList = matches[wikiKey];
-        
-        
-        for (const QPair<int, QString>& match : matchesList) {
-            int startPos = match.first;
-            QString matchedText = match.second;
-            int endPos = startPos + matchedText.length();
-            qDebug() << "startPos: " << startPos;
-            qDebug() << "matchedText: " << matchedText;
-            qDebug() << "endPos: " << endPos;
-            
-            // Iterate through each character in the matched text
-            QVector<QRectF> rects;
-            for (int pos = startPos; pos < endPos; ++pos) {
-                // Get the line containing this character
-                QTextLine line = layout->lineForTextPosition(pos);
-                if (!line.isValid()) continue;
-
-                // Get x-position for this character
-                int relativePos = pos;
-                int lineStartPos = line.textStart();
-                int posInLine = relativePos - lineStartPos;
-                
-                // Skip if position is invalid
-                if (posInLine < 0 || posInLine >= line.textLength()) continue;
-
-                // Get the block's left margin from its format
-                qreal leftMargin = block.blockFormat().leftMargin();
-
-                // Get x-position including margin
-                qreal x = line.cursorToX(relativePos);
-                qreal nextX;
-                
-                // Get the right edge of the current character
-                if (posInLine + 1 >= line.textLength()) {
-                    // For the last character in line, use the line's natural width plus margin
-                    nextX = line.naturalTextWidth() + leftMargin;
-                } else {
-                    // For all other characters, use the next character's position plus margin
-                    nextX = line.cursorToX(relativePos + 1);
-                }
+    for (int index : candidates) {
+        WikiBlockData::Span& span = data->span(index);
+        if (span.rectsGeneration != wikiLayoutGeneration) {
+            updateWikiSpanRects(block, span);
+        }
 
-                // Create rectangle for this character
-                QRectF charRect(
-                    blockPos.x() + x,
-                    blockPos.y() + line.y(),
-                    nextX - x,
-                    line.height()
-                );
+        // Check if mouse is over any of the rectangles
+        for (const QRectF& rect : span.rects) {
+            // Convert block coordinates to viewport coordinates
+            QRectF adjustedRect = rect.translated(blockPos - viewportOffset);
 
-                // Only add non-zero width rectangles
-                rects.append(charRect);
-            }
+            // Add padding for easier hit detection
+            QRectF hitRect = adjustedRect.adjusted(-5, -5, 5, 5);
 
-            // Now merge rectangles that are on the same line
-            QVector<QRectF> mergedRects;
-            for (const QRectF& charRect : rects) {
-                if (mergedRects.isEmpty() || 
-                    qAbs(mergedRects.last().top() - charRect.top()) > 1) {
-                    // New line, add new rectangle
-                    mergedRects.append(charRect);
-                } else {
-                    // Same line, merge with previous rectangle
-                    QRectF& lastRect = mergedRects.last();
-                    lastRect.setRight(charRect.right());
-                }
-            }
-            rects = mergedRects;
-
-            // Check if mouse is over any of the rectangles
-            for (const QRectF& rect : rects) {
-                // Convert document coordinates to viewport coordinates
-                QRect viewportRect = viewport()->rect();
-                QPointF viewportOffset(horizontalScrollBar()->value(), verticalScrollBar()->value());
-                QRectF adjustedRect = rect.translated(-viewportOffset);
-                
-                // Add padding for easier hit detection
-                QRectF hitRect = adjustedRect.adjusted(-5, -5, 5, 5);
-                
-                if (hitRect.contains(lastMousePos)) {
-                    matchedWikiKeysSet.insert(wikiKey);  // Use insert() to ensure uniqueness
-                    
-                }
+            if (hitRect.contains(lastMousePos)) {
+                matchedWikiKeysSet.insert(span.key);  // Use insert() to ensure uniqueness
             }
         }
     }
@@ -1265,8 +1894,84 @@ void FictionTextEdit::readBlock() {
     emit showWikiAt(fullMatchedContent, globalPos);
 }
 
+/*
+Wiki matches of `block`, searched once and then kept in the block's user
+data until its text or the wiki changes.
+*/
+WikiBlockData* FictionTextEdit::wikiSpansFor(QTextBlock block) {
+    auto* data = static_cast<WikiBlockData*>(block.userData());
+    if (data && data->wikiGeneration() == wikiGeneration) {
+        return data;
+    }
+
+    QMap<QString, QList<QPair<int, QString>>> matches = projectManager->matchWikiContent(block.text());
+    std::vector<WikiBlockData::Span> spans;
+    for (auto it = matches.cbegin(); it != matches.cend(); ++it) {
+        for (const QPair<int, QString>& match : it.value()) {
+            WikiBlockData::Span span;
+            span.start = match.first;
+            span.end = match.first + match.second.length();
+            span.key = it.key();
+            spans.push_back(std::move(span));
+        }
+    }
+
+    // Replaces (and deletes) the stale data
+    data = new WikiBlockData(std::move(spans), wikiGeneration);
+    block.setUserData(data);
+    return data;
+}
+
+/*
+One rectangle per line `span` covers, relative to the block's top left.
+*/
+void FictionTextEdit::updateWikiSpanRects(const QTextBlock &block, WikiBlockData::Span &span) {
+    span.rects.clear();
+    span.rectsGeneration = wikiLayoutGeneration;
+
+    QTextLayout* layout = block.layout();
+    for (int i = 0; i < layout->lineCount(); ++i) {
+        QTextLine line = layout->lineAt(i);
+        int lineStart = line.textStart();
+        int lineEnd = lineStart + line.textLength();
+        if (lineEnd <= span.start || lineStart >= span.end) {
+            continue;
+        }
+
+        qreal x = line.cursorToX(qMax(span.start, lineStart));
+        qreal nextX = span.end >= lineEnd
+                          // Up to the end of the line's text
+                          ? line.x() + line.naturalTextWidth()
+                          : line.cursorToX(span.end);
+        span.rects.append(QRectF(x, line.y(), nextX - x, line.height()));
+    }
+}
+
+/*
+Drop the wiki spans of every paragraph an edit touched, they are searched
+again when hovered.
+*/
+void FictionTextEdit::invalidateWikiSpans(int position, int charsRemoved, int charsAdded) {
+    Q_UNUSED(charsRemoved);
+    QTextBlock block = document()->findBlock(position);
+    QTextBlock last = document()->findBlock(position + charsAdded);
+    while (block.isValid()) {
+        if (block.userData()) {
+            block.setUserData(nullptr);
+        }
+        if (block == last) {
+            break;
+        }
+        block = block.next();
+    }
+}
+
 void FictionTextEdit::showContextMenu(const QPoint &pos) {
-    ContextMenuUtil::showContextMenu(this, pos);
+    if (segments) {
+        ContextMenuUtil::showContextMenu(this, pos, !pagedUndo.empty(), !pagedRedo.empty());
+    } else {
+        ContextMenuUtil::showContextMenu(this, pos);
+    }
 }
 
 void FictionTextEdit::scrollToCenter(const QTextBlock &block) {
@@ -7,6 +7,8 @@
 #include "projectmanager.h"
 #include "utils/fictionhighlighter.h"
 #include "utils/contextmenuutil.h"
+#include "utils/wikiblockdata.h"
+#include "utils/segmentedtext.h"
 #include "prisonermanager.h"
 
 #include <QAbstractTextDocumentLayout>
@@ -26,6 +28,7 @@
 #include <QTextBlock>
 #include <QTimer>
 #include <QScrollBar>
+#include <QSignalBlocker>
 #include <QString>
 #include <QStringMatcher>
 #include <QTextImageFormat> // tobe removed
@@ -33,6 +36,9 @@
 #include <QFutureWatcher>
 #include <qtconcurrentrun.h>
 #include <QPropertyAnimation>
+#include <atomic>
+#include <functional>
+#include <memory>
 
 
 class FictionTextEdit : public QTextEdit
@@ -45,11 +51,17 @@ public:
         ProjectManager *projectManager = nullptr,
         PrisonerManager *prisonerManager = nullptr
     );
+    ~FictionTextEdit();
 
     bool isSniperMode;
 
     void load(const QString& text, bool keepCursorPlace = false);
+    QString fullText(); // the whole manuscript, also in paged mode
+    int countWords(const std::function<int(const QString &)> &counter);
+    void undo();    // QTextEdit's, or in paged mode the edit's own history
+    void redo();
     void setTopMargin(int margin);
+    void setBottomMargin(int margin);
     virtual void activateSniperMode();
     virtual void deactivateSniperMode();
     void search(const QString &searchString);
@@ -69,6 +81,7 @@ signals:
     void keyboardInput();
     void showWikiAt(const QString &wikiContent, QPoint lastMousePos);
     void hideWiki();
+    void redactionProgress(int percent); // masking a large text in the background, 100 = done
 
 protected:
     void keyPressEvent(QKeyEvent *event) override;
@@ -108,9 +121,27 @@ private:
     void onBlockSearchComplete();
     void refresh();
     void onTextChanged();
+    void trackChangedRange(int position, int charsRemoved, int charsAdded);
+    void recordPagedEdit(int position, int charsRemoved, int charsAdded);
+    void replacePagedRange(qsizetype position, qsizetype length, const QString &text);
+    void startRedaction(int start, int end);
+    void onRedactionFinished();
+    void applyRedaction(const std::vector<std::pair<int, int>> &ranges);
+    void applyMaskedRanges(int offset, const QString &text, const std::vector<std::pair<int, int>> &ranges);
     void updateCursorPosition();
     void readBlock();
+    WikiBlockData* wikiSpansFor(QTextBlock block);
+    void updateWikiSpanRects(const QTextBlock &block, WikiBlockData::Span &span);
+    void invalidateWikiSpans(int position, int charsRemoved, int charsAdded);
     void scrollToCenter(const QTextBlock &block);
+    void setDocumentText(const QString &text, bool keepCursorPlace);
+    void applyRootMargins();
+    bool isTitleBlock(const QTextBlock &block) const;
+    void showSegments(int center, qreal offset, qsizetype cursorPosition = -1);
+    void commitSegmentWindow();
+    void measureSegmentWindow();
+    void updateSegmentWindow();
+    void selectTextRange(qsizetype start, qsizetype length);
     // void toggleCursorVisibility();
 
     int globalFontSize;
@@ -123,13 +154,54 @@ private:
     ProjectManager *projectManager;
     PrisonerManager *prisonerManager;
     QString previousText;
-    int previousDocumentLength;
-    int previousCursorPosition;
-    QString previousDocumentText;
+    int changedStart;           // text changed since the last refresh(), -1 if none
+    int changedEnd;             // one past the last changed position
+    bool ignoreContentsChange;  // refresh() masking or reformatting, not tracked
+
+    // Background masking of large ranges (paste, load), see startRedaction()
+    static constexpr int backgroundRedactionUnits = 64 * 1024;
+    static constexpr int redactionProgressUnits = 1024 * 1024;
+    QFutureWatcher<std::vector<std::pair<int, int>>> *redactionWatcher;
+    QTimer *redactionProgressTimer;
+    QString redactionText;      // snapshot the job scans
+    int redactionStart;         // where the snapshot is in the document now,
+    int redactionEnd;           // moved along by edits made meanwhile
+    int redactionEditStart;     // edits made meanwhile inside the snapshot, -1 if none
+    int redactionEditEnd;
+    std::shared_ptr<std::atomic<bool>> redactionCancel;
+    std::shared_ptr<std::atomic<qsizetype>> redactionDone;
+    bool redactionPending;
+
+    // Paged mode for very long manuscripts, see load(). The document then
+    // only holds segments windowFirst..windowLast-1, the root frame's top
+    // and bottom margins stand in for the segments above and below.
+    static constexpr qsizetype pagedModeUnits = 1024 * 1024;
+    std::unique_ptr<SegmentedText> segments;   // null when the whole file is loaded
+    int windowFirst;
+    int windowLast;
+    bool segmentWindowDirty;    // the document changed since the segments were written
+
+    // Paged mode's undo history. Swapping segments rewrites the document,
+    // which QTextDocument's own history does not survive, so edits are kept
+    // here with positions in the whole manuscript, see undo().
+    struct PagedEdit {
+        qsizetype position;
+        QString removed;
+        QString added;
+    };
+    std::vector<PagedEdit> pagedUndo;
+    std::vector<PagedEdit> pagedRedo;
+    QString windowText;         // the document's text, to know what an edit removed
+    bool recordPagedEdits;      // false while swapping segments or undoing
+    int topMargin;              // root frame margins without the hidden segments
+    int bottomMargin;
+    QTimer *segmentWindowTimer; // debounces scrolling
     
     QTimer *timer;
     QTimer *refreshTimer;
     QPoint lastMousePos;
+    int wikiGeneration;         // bumped when the wiki changes, stale block spans are redone
+    int wikiLayoutGeneration;   // bumped on relayout, stale span rectangles are redone
     bool isInit;
     // Threading support for block computation
     QFutureWatcher<int> *blockSearchWatcher;
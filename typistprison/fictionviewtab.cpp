@@ -165,6 +165,7 @@ FictionViewTab::FictionViewTab(const QString &content,
     connect(textEdit, &FictionTextEdit::textChanged, this, &FictionViewTab::updateWordcount);
     connect(textEdit, &FictionTextEdit::showWikiAt, this, &FictionViewTab::showWikiFunc);
     connect(textEdit, &FictionTextEdit::hideWiki, this, &FictionViewTab::hideWikiFunc);
+    connect(textEdit, &FictionTextEdit::redactionProgress, this, &FictionViewTab::showRedactionProgress);
     connect(prisonerButton, &QPushButton::clicked, this, &FictionViewTab::activatePrisonerMode);
     
     // Install event filters for hover detection on buttons
@@ -191,11 +192,12 @@ void FictionViewTab::setupTextEdit(const QString &content) {
     QTextDocument *doc = textEdit->document();
     QTextFrame *rootFrame = doc->rootFrame();
     QTextFrameFormat format = rootFrame->frameFormat();
-    format.setTopMargin(128);
-    format.setBottomMargin(256);
     format.setLeftMargin(16);
     format.setRightMargin(16);
     rootFrame->setFrameFormat(format);
+    // top and bottom go through the edit, it adds hidden segments in paged mode
+    textEdit->setTopMargin(128);
+    textEdit->setBottomMargin(256);
 }
 
 void FictionViewTab::setupScrollBar() {
@@ -311,7 +313,7 @@ bool FictionViewTab::saveContent() {
         }
 
         QTextStream out(&file);
-        out << textEdit->toPlainText();
+        out << textEdit->fullText();
         file.close();
 
         emit onChangeFileType(fileName);
@@ -326,7 +328,7 @@ bool FictionViewTab::saveContent() {
     }
 
     QTextStream out(&file);
-    out << textEdit->toPlainText();
+    out << textEdit->fullText();
     file.close();
 
     emit onChangeTabName(QFileInfo(currentFilePath).fileName());
@@ -340,26 +342,28 @@ void FictionViewTab::editContent() {
 
 int FictionViewTab::getBaseWordCount() {
     qDebug() << "FictionViewTab::getBaseWordCount";
-    QString text = textEdit->toPlainText();
-    if (text.isEmpty()) {
-        return 0;
-    }
+    // in paged mode only the segments being edited are counted again
+    return textEdit->countWords([this](const QString &text) {
+        if (text.isEmpty()) {
+            return 0;
+        }
 
-    int wordCount = 0;
+        int wordCount = 0;
 
-    QRegularExpressionMatchIterator i = alphabeticRegex.globalMatch(text);
-    while (i.hasNext()) {
-        i.next();
-        wordCount++;
-    }
+        QRegularExpressionMatchIterator i = alphabeticRegex.globalMatch(text);
+        while (i.hasNext()) {
+            i.next();
+            wordCount++;
+        }
 
-    i = cjkRegex.globalMatch(text);
-    while (i.hasNext()) {
-        i.next();
-        wordCount++;
-    }
+        i = cjkRegex.globalMatch(text);
+        while (i.hasNext()) {
+            i.next();
+            wordCount++;
+        }
 
-    return wordCount;
+        return wordCount;
+    });
 }
 
 void FictionViewTab::updateWordcount() {
@@ -383,6 +387,18 @@ void FictionViewTab::updateWordcount() {
     }
 }
 
+/*
+Large pastes and files are filtered for banned words in the background,
+the word count label shows how far that got until it is done.
+*/
+void FictionViewTab::showRedactionProgress(int percent) {
+    if (percent < 100) {
+        wordCountLabel->setText("Masking " + QString::number(percent) + "%");
+    } else {
+        wordCountLabel->setText(QString::number(this->getBaseWordCount()) + " words");
+    }
+}
+
 void FictionViewTab::activatePrisonerMode() {
     qDebug() << "FictionViewTab::activatePrisonerMode";
     // create a dialog for setting goal and time limit
@@ -425,7 +441,7 @@ void FictionViewTab::activatePrisonerMode() {
     connect(prisonerButton, &QPushButton::clicked, this, &FictionViewTab::deactivatePrisonerMode);
 
     // get all text edit content
-    prisonerInitialContent = textEdit->toPlainText();
+    prisonerInitialContent = textEdit->fullText();
 
     connect(prisonerManager,
             &PrisonerManager::prisonerModeFailed,
@@ -565,7 +581,7 @@ void FictionViewTab::escapePrisonerMode() {
 }
 
 QString FictionViewTab::getTextContent() const {
-    return textEdit->toPlainText();
+    return textEdit->fullText();
 }
 
 bool FictionViewTab::isInPrisonerMode() const {
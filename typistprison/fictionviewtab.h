@@ -75,6 +75,7 @@ private:
     void editContent();
     bool saveContent() override;
     void updateWordcount();
+    void showRedactionProgress(int percent);
     int getBaseWordCount();
     void activatePrisonerMode();
     void deactivatePrisonerMode();
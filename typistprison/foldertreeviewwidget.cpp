@@ -17,6 +17,7 @@
 #include <QClipboard>
 #include <QGuiApplication>
 #include <QLabel>
+#include <QLocale>
 
 FolderTreeViewWidget::FolderTreeViewWidget(QWidget *parent,
                    QString folderRoot,
@@ -26,6 +27,7 @@ FolderTreeViewWidget::FolderTreeViewWidget(QWidget *parent,
       fileTreeView(nullptr),
       layout(nullptr),
       buttonWidget(nullptr),
+      titleLabel(nullptr),
       projectManager(projectManager)
 {
     this->setStyleSheet(
@@ -76,6 +78,7 @@ void FolderTreeViewWidget::resizeEvent(QResizeEvent* event)
 
 void FolderTreeViewWidget::enterEvent(QEnterEvent* event)
 {
+    updateProjectToolTip();
     FadeAnimationUtil::fadeOut(overlayWidget, 150);
     QWidget::enterEvent(event);
 }
@@ -86,6 +89,20 @@ void FolderTreeViewWidget::leaveEvent(QEvent* event)
     QWidget::leaveEvent(event);
 }
 
+/*
+Show the project name and how much memory its banned words and wiki
+automata take on the project label.
+*/
+void FolderTreeViewWidget::updateProjectToolTip()
+{
+    if (!titleLabel || !projectManager || !projectManager->isLoadedProject) {
+        return;
+    }
+    QString name = QFileInfo(folderRoot).fileName();
+    QString size = QLocale().formattedDataSize(static_cast<qint64>(projectManager->bytesUsed()));
+    titleLabel->setToolTip(name + "\nBanned words & wiki: " + size);
+}
+
 // In the refresh method, ensure the overlay is properly handled
 void FolderTreeViewWidget::refresh(const QString &newFolderRoot) {
     qDebug() << "REFRESH - Checking fileTreeView:" << (fileTreeView ? "exists" : "NULL");
@@ -137,7 +154,7 @@ void FolderTreeViewWidget::setupButton() {
     QString path = QDir::toNativeSeparators(folderRoot);
     QString deepestFolder = path.split(QDir::separator()).last();  // Get the last folder name
     QString firstLetter = deepestFolder.isEmpty() ? QString("E") : deepestFolder.at(0);
-    QLabel *titleLabel = new QLabel(firstLetter, this);
+    titleLabel = new QLabel(firstLetter, this);
     titleLabel->setStyleSheet(
         "QLabel {"
         "    color: #545555;"
@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QFileSystemModel>
+#include <QLabel>
 #include <QTreeView>
 #include <QVBoxLayout>
 #include <QGraphicsDropShadowEffect>
@@ -33,10 +34,12 @@ private:
     void addFile(const QString &targetDir = QString());
     void addFolder(const QString &targetDir = QString());
     void onDoubleClicked(const QModelIndex &index);
+    void updateProjectToolTip();
 
     QFileSystemModel *fileModel;    // Pointer to the file system model
     QTreeView *fileTreeView;        // Pointer to the QTreeView
     QWidget *buttonWidget;          // Add this member variable to hold the button widget
+    QLabel *titleLabel;             // Project initial, tooltip shows project memory use
     QVBoxLayout *layout;            // Pointer to the QVBoxLayout
     qreal scalingFactor;            // Correctly call devicePixelRatio()
     QString folderRoot;       // project root
@@ -1,16 +1,25 @@
 #include "projectmanager.h"
+#include "utils/bannedpattern.h"
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDebug>
 #include <QTimer>
 #include <QDirIterator>
-#include <QRegularExpression>
+#include <qtconcurrentmap.h>
+#include <qtconcurrentrun.h>
 
 /*
 This class manage the project(folder) of typrison, including:
 - banned words
 - wiki folder or file
 
-TODO: have a easy method to handle when banned words file is changed
-and wiki folder or file is changed.
+The banned words lists are watched with QFileSystemWatcher and rebuilt when
+they change.
+
+The wiki is indexed in the background when a project is opened, files that
+did not change since the last open are not parsed again.
+
+TODO: have a easy method to handle when wiki folder or file is changed.
 */
 
 // Constructor
@@ -18,443 +27,967 @@ ProjectManager::ProjectManager(QObject* parent)
     : QObject(parent)
     , isLoadedProject(false)
     , haveBannedWordsFile(false)
-    , maxiumBannedWordLength(0)
+    , haveWiki(false)
+    , bannedWordsFileWatcher(new QFileSystemWatcher(this))
     , bannedWordsTimer(new QTimer(this))
+    , bannedWordsWatcher(new QFutureWatcher<bool>(this))
+    , bannedWordsFromCache(false)
+    , bannedWordsReloadPending(false)
     , currentProjectRoot("")
+    , wikiTrieMissing(false)
+    , wikiWatcher(new QFutureWatcher<bool>(this))
+    , wikiReloadPending(false)
 {
-    // Set up timer to check for banned words file changes
+    // Editors save in bursts (truncate, write, rename), only look once it settles
+    bannedWordsTimer->setSingleShot(true);
+    bannedWordsTimer->setInterval(300);
     connect(bannedWordsTimer, &QTimer::timeout, this, &ProjectManager::checkBannedWordsChanges);
+    connect(bannedWordsFileWatcher, &QFileSystemWatcher::fileChanged,
+            bannedWordsTimer, qOverload<>(&QTimer::start));
+    connect(bannedWordsFileWatcher, &QFileSystemWatcher::directoryChanged,
+            bannedWordsTimer, qOverload<>(&QTimer::start));
+    connect(bannedWordsWatcher, &QFutureWatcher<bool>::finished, this, &ProjectManager::onBannedWordsRebuilt);
+    connect(wikiWatcher, &QFutureWatcher<bool>::finished, this, &ProjectManager::onWikiRebuilt);
+}
+
+ProjectManager::~ProjectManager() {
+    // The build jobs work on our members
+    bannedWordsWatcher->waitForFinished();
+    wikiWatcher->waitForFinished();
 }
 
 void ProjectManager::open(const QString selectedProjectRoot) {
     currentProjectRoot = selectedProjectRoot;
-    readBannedWords(selectedProjectRoot);
-    readWikiFiles(selectedProjectRoot);
+    reloadBannedWords();
+    reloadWiki();
 
     isLoadedProject = true;
-    
-    // Start the timer to check for banned words changes every second
-    bannedWordsTimer->start(1000);
+
+    // Added, removed or renamed files show up on the project root, edits on
+    // the lists themselves; those are watched once they are known
+    QStringList watched = bannedWordsFileWatcher->files() + bannedWordsFileWatcher->directories();
+    if (!watched.isEmpty()) {
+        bannedWordsFileWatcher->removePaths(watched);
+    }
+    bannedWordsFileWatcher->addPath(selectedProjectRoot);
 
     return;
 }
 
-void ProjectManager::readBannedWords(const QString selectedProjectRoot) {
-    maxiumBannedWordLength = 0;
+/*
+Read the shared banned words directories of `projectRoot` from
+.typrison/banned-words-dirs.txt, one directory per line. Relative paths are
+taken from the project root, lines starting with '#' are comments.
+
+returns: QStringList
+    absolute paths of the directories that exist
+*/
+QStringList ProjectManager::readBannedWordsDirs(const QString& projectRoot) {
+    QDir projectDir(projectRoot);
+    QFile file(projectDir.filePath(".typrison/banned-words-dirs.txt"));
+    QStringList dirs;
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return dirs;
+    }
+
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+        QString dir = QDir::cleanPath(projectDir.absoluteFilePath(line));
+        if (QFileInfo(dir).isDir() && !dirs.contains(dir)) {
+            dirs.append(dir);
+        }
+    }
+    return dirs;
+}
+
+/*
+Find the banned words lists in `projectRoot` and `sharedDirs`: .txt files
+whose name is only asterisks, optionally followed by ".warn" or
+".highlight" for the policy.
 
-    // Step 1: Locate all .txt files
-    QDir directory(selectedProjectRoot);
-    QStringList txtFiles = directory.entryList(QStringList() << "*.txt", QDir::Files);
+returns: std::vector<std::pair<QString, BannedWordsPolicy>>
+    file path and policy of every list, shared directories first
+*/
+std::vector<std::pair<QString, BannedWordsPolicy>> ProjectManager::findBannedWordsFiles(
+    const QString& projectRoot, const QStringList& sharedDirs) {
+    std::vector<std::pair<QString, BannedWordsPolicy>> files;
+    QStringList dirs = sharedDirs;
+    dirs.append(projectRoot);
+
+    for (const QString& dirPath : dirs) {
+        QDir directory(dirPath);
+        QStringList txtFiles = directory.entryList(QStringList() << "*.txt", QDir::Files, QDir::Name);
 
-    // Step 2: Identify the file with the longest sequence of '*'
-    QString bestFile;
-    int maxStars = 0;
+        for (const QString& fileName : txtFiles) {
+            QString stem = fileName.left(fileName.length() - 4); // remove ".txt"
+            BannedWordsPolicy policy = BannedWordsPolicy::Mask;
+            if (stem.endsWith(".warn")) {
+                policy = BannedWordsPolicy::Warn;
+                stem.chop(5);
+            } else if (stem.endsWith(".highlight")) {
+                policy = BannedWordsPolicy::Highlight;
+                stem.chop(10);
+            }
 
-    for (const QString& fileName : txtFiles) {
-        bool allAsterisks = false;
-        if (fileName.length() > 4) {
-            QString firstHalf = fileName.left(fileName.length() - 4); // remove last 4 characters
-            allAsterisks = std::all_of(firstHalf.begin(), firstHalf.end(),
-                                            [](QChar ch) { return ch == '*'; });
+            bool allAsterisks = !stem.isEmpty() && std::all_of(stem.begin(), stem.end(),
+                                                                [](QChar ch) { return ch == '*'; });
+            if (allAsterisks) {
+                files.emplace_back(directory.filePath(fileName), policy);
+            }
         }
-        
-        if (allAsterisks) {
-            int starCount = fileName.count('*');
-            if (starCount > maxStars) {
-                maxStars = starCount;
-                bestFile = fileName;
+    }
+    return files;
+}
+
+/*
+Start a banned words build on the thread pool.
+
+Builds never overlap: if one is running, another one is queued and started
+from onBannedWordsRebuilt().
+*/
+void ProjectManager::reloadBannedWords() {
+    if (bannedWordsWatcher->isRunning()) {
+        bannedWordsReloadPending = true;
+        return;
+    }
+    bannedWordsReloadPending = false;
+
+    QString projectRoot = currentProjectRoot;
+    bannedWordsWatcher->setFuture(QtConcurrent::run([this, projectRoot]() {
+        return rebuildBannedWords(projectRoot);
+    }));
+}
+
+// Runs on a worker thread, forget every list
+void ProjectManager::clearBannedWords() {
+    bannedWordsLists.clear();
+    bannedWordsTags.clear();
+    freeBannedWordsIndexes.clear();
+    bannedWordsTrie.clear();
+    bannedWordsFromCache = false;
+}
+
+// Runs on a worker thread, take the words of `list` out of the trie
+void ProjectManager::removeBannedWordsList(BannedWordsList& list) {
+    for (auto it = list.words.cbegin(); it != list.words.cend(); ++it) {
+        bannedWordsTrie.removeWithoutRebuild(it.key(), it.value());
+        freeBannedWordsIndexes.push_back(it.value());
+    }
+    list.words.clear();
+}
+
+/*
+Runs on a worker thread.
+
+Bring the banned words trie in line with the lists on disk, compile it and
+publish the result as a new BannedWords. All lists share one trie, each word
+is a pattern of its own tagged with the policy of its list, so a word in two
+lists is found once per list. A /pattern/ line adds every word it expands to
+(see BannedPattern). Only lists whose contents changed are read
+again and diffed against what the trie holds for them. Pattern indexes stay
+stable across rebuilds: removed words leave a free slot that is reused by
+the next new word.
+
+The first build for a project tries the compiled cache in the project's
+.typrison folder and skips parsing the lists altogether when it matches.
+Every fresh build refreshes that cache.
+
+returns: bool
+    true if a new build (or none) was published
+*/
+bool ProjectManager::rebuildBannedWords(const QString projectRoot) {
+    // The build still published belongs to the last project
+    bool newProject = projectRoot != bannedWordsProjectRoot;
+    if (newProject) {
+        // Another project, start over
+        clearBannedWords();
+        bannedWordsProjectRoot = projectRoot;
+    }
+    bannedWordsDirs = readBannedWordsDirs(projectRoot);
+    std::vector<std::pair<QString, BannedWordsPolicy>> files = findBannedWordsFiles(projectRoot, bannedWordsDirs);
+    bool published = std::atomic_load(&bannedWords) != nullptr;
+
+    // If no banned words file found, drop the current build
+    if (files.empty()) {
+        clearBannedWords();
+        if (published) {
+            std::atomic_store(&bannedWords, std::shared_ptr<const BannedWords>());
+            return true;
+        }
+        return false;
+    }
+
+    // Match every file with what the last build knew about it
+    std::vector<BannedWordsList> lists;
+    std::vector<bool> known(bannedWordsLists.size(), false);
+    bool sameFiles = published && files.size() == bannedWordsLists.size();
+    for (const auto& file : files) {
+        BannedWordsList list;
+        list.path = file.first;
+        list.policy = file.second;
+        for (size_t k = 0; k < bannedWordsLists.size(); ++k) {
+            if (!known[k] && bannedWordsLists[k].path == list.path && bannedWordsLists[k].policy == list.policy) {
+                known[k] = true;
+                list.source = bannedWordsLists[k].source;
+                list.words = std::move(bannedWordsLists[k].words);
+                break;
             }
         }
+        sameFiles = sameFiles && list.source.size >= 0;
+        lists.push_back(std::move(list));
     }
 
-    // Step 3: Read the contents of the selected file
-    if (!bestFile.isEmpty()) {
-        QFile file(directory.filePath(bestFile));
-        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            qWarning() << "Could not open file:" << bestFile;
-            return;
+    // A build from the cache has no words to diff against, read everything
+    bool fullBuild = newProject || !published || bannedWordsFromCache;
+
+    // Same size and time as the last build, don't even open them
+    std::vector<QByteArray> contents(lists.size());
+    std::vector<bool> changed(lists.size(), false);
+    bool anyChanged = !sameFiles;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        BannedWordsList& list = lists[i];
+        bool sameStat = list.source.size >= 0
+                        && AutomatonCache::statFingerprint(list.path).sameStat(list.source);
+        if (sameStat && !fullBuild) {
+            continue;
+        }
+
+        // Read the current contents of the file
+        QFile file(list.path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qWarning() << "Could not open file:" << list.path;
+            continue; // keep what we had, if anything
+        }
+        contents[i] = file.readAll();
+        file.close();
+
+        SourceFingerprint source = AutomatonCache::fingerprint(list.path, contents[i]);
+        changed[i] = source.hash != list.source.hash;
+        anyChanged = anyChanged || changed[i];
+        list.source = source; // new size and time even if the contents are the same
+    }
+
+    if (!anyChanged) {
+        bannedWordsLists = std::move(lists);
+        return false;
+    }
+
+    // Names all lists at once: which files, with which policy and contents
+    SourceFingerprint combined;
+    combined.size = 0;
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    for (const BannedWordsList& list : lists) {
+        combined.size += list.source.size;
+        combined.modified = std::max(combined.modified, list.source.modified);
+        hash.addData(list.path.toUtf8());
+        hash.addData(QByteArray(1, static_cast<char>(list.policy)));
+        hash.addData(list.source.hash);
+    }
+    combined.hash = hash.result();
+    QString cachePath = QDir(projectRoot).filePath(".typrison/bannedwords.cache");
+
+    if (fullBuild) {
+        clearBannedWords();
+        for (BannedWordsList& list : lists) {
+            list.words.clear();
+        }
+        if (newProject || !published) {
+            auto cached = std::make_shared<BannedWords>();
+            if (AutomatonCache::load(cachePath, combined, cached->automaton)) {
+                bannedWordsLists = std::move(lists);
+                bannedWordsFromCache = true;
+                std::atomic_store(&bannedWords, std::shared_ptr<const BannedWords>(std::move(cached)));
+                return true;
+            }
         }
+        std::fill(changed.begin(), changed.end(), true);
+    }
+
+    // Lists that are gone take their words with them
+    for (size_t k = 0; k < bannedWordsLists.size(); ++k) {
+        if (!known[k] && !fullBuild) {
+            removeBannedWordsList(bannedWordsLists[k]);
+        }
+    }
 
-        QTextStream in(&file);
-        std::vector<std::string> lines;
-        std::unordered_set<std::string> uniqueLines;
+    for (size_t i = 0; i < lists.size(); ++i) {
+        if (!changed[i]) {
+            continue;
+        }
+        BannedWordsList& list = lists[i];
+
+        QTextStream in(contents[i]);
+        QSet<QString> uniqueLines;
+        std::vector<QString> newLines;
+        std::vector<QString> words;
         while (!in.atEnd()) {
             QString line = in.readLine();
-            std::string lineStr = line.toStdString();
 
-            // Check if the line is already present
-            if (uniqueLines.find(lineStr) == uniqueLines.end()) {
-                lines.push_back(lineStr);
-                uniqueLines.insert(lineStr); // Mark as added
+            // A /pattern/ line stands for all the words it matches
+            words.clear();
+            if (!BannedPattern::isPattern(line)) {
+                words.push_back(line);
+            } else if (!BannedPattern::expand(line, words)) {
+                qWarning() << "Skipping banned words pattern:" << line << "in" << list.path;
             }
-        }
-        file.close();
 
-        bannedWordsLines = lines;
+            for (const QString& word : words) {
+                // Skip empty and repeated words
+                if (word.isEmpty() || uniqueLines.contains(word)) {
+                    continue;
+                }
+                uniqueLines.insert(word);
+                if (!list.words.contains(word)) {
+                    newLines.push_back(word);
+                }
+            }
+        }
 
-        QString bannedWordsQstringList;
-        for (const auto& str : bannedWordsLines) {
-            bannedWordsQstringList.append(QString::fromUtf8(str.c_str()));
-            QString banneWordQSR = QString::fromUtf8(str.c_str());
-            maxiumBannedWordLength = std::max(static_cast<int>(banneWordQSR.length()), maxiumBannedWordLength);
+        // Remove words that are no longer in the file
+        for (auto it = list.words.begin(); it != list.words.end();) {
+            if (uniqueLines.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            bannedWordsTrie.removeWithoutRebuild(it.key(), it.value());
+            freeBannedWordsIndexes.push_back(it.value());
+            it = list.words.erase(it);
         }
 
-        AhoCorasick trie;
-        for (size_t i = 0; i < lines.size(); ++i) {
-            trie.insert(lines[i], i);
+        // Add new words to the trie, reusing free indexes first
+        for (const auto& newLine : newLines) {
+            int index;
+            if (freeBannedWordsIndexes.empty()) {
+                index = static_cast<int>(bannedWordsTags.size());
+                bannedWordsTags.push_back(0);
+            } else {
+                index = freeBannedWordsIndexes.back();
+                freeBannedWordsIndexes.pop_back();
+            }
+            bannedWordsTags[index] = static_cast<quint8>(list.policy);
+            list.words.insert(newLine, index);
+            bannedWordsTrie.insert(newLine, index);
         }
-        trie.buildFailureLinks();
+    }
+    bannedWordsLists = std::move(lists);
+    bannedWordsTrie.buildFailureLinks();
 
-        bannedWordsTrie = trie;
-        haveBannedWordsFile = true;
-    } else {
-        haveBannedWordsFile = false;
+    auto build = std::make_shared<BannedWords>();
+    // banned words are scanned on every edit, trade memory for a flat DFA
+    build->automaton = CompiledAhoCorasick(bannedWordsTrie, CompiledAhoCorasick::Mode::Dfa, bannedWordsTags);
+    build->trieBytes = bannedWordsTrie.bytesUsed();
+
+    AutomatonCache::save(cachePath, combined, build->automaton);
+    std::atomic_store(&bannedWords, std::shared_ptr<const BannedWords>(std::move(build)));
+    return true;
+}
+
+void ProjectManager::onBannedWordsRebuilt() {
+    haveBannedWordsFile = std::atomic_load(&bannedWords) != nullptr;
+    watchBannedWordsFiles();
+    if (bannedWordsWatcher->result()) {
+        emit bannedWordsChanged();
+    }
+    if (bannedWordsReloadPending) {
+        reloadBannedWords();
     }
 }
 
 int ProjectManager::getMaxiumBannedWordLength() {
-    return maxiumBannedWordLength;
+    std::shared_ptr<const BannedWords> current = std::atomic_load(&bannedWords);
+    return current ? current->automaton.longestPattern() : 0;
+}
+
+size_t ProjectManager::bytesUsed() const {
+    size_t total = 0;
+    // The tries belong to the build jobs, use the sizes they recorded
+    std::shared_ptr<const BannedWords> current = std::atomic_load(&bannedWords);
+    if (current) {
+        total += current->trieBytes + current->automaton.bytesUsed();
+    }
+    std::shared_ptr<const WikiIndex> wiki = std::atomic_load(&wikiIndex);
+    if (wiki) {
+        total += wiki->trieBytes + wiki->automaton.bytesUsed();
+    }
+    return total;
 }
 
 QString ProjectManager::matchBannedWords(QString text) {
+    // Hold on to the current build, a rebuild may publish a new one meanwhile
+    std::shared_ptr<const BannedWords> current = std::atomic_load(&bannedWords);
+
     // If no banned words file is found, return original text
-    if (!haveBannedWordsFile) {
+    if (!current) {
         return text;
     }
 
-    std::string stdStringText = text.toStdString();
-    std::vector<std::pair<int, int>> matches = bannedWordsTrie.search(stdStringText);
+    // Positions are QString positions, every masked QChar becomes one '*'
+    return current->automaton.redact(text, static_cast<int>(BannedWordsPolicy::Mask));
+}
 
-    int backspace = 0;
+/*
+Find what matchBannedWords() would mask in `text`, without copying it: the
+covered ranges as (start, end) QString positions, end exclusive, merged
+and in order. Overlapping and touching words make one range.
 
-    for (const auto& match : matches) {
-        int patternIndex = match.first;
-        int utf8BannedWordLength = bannedWordsLines[patternIndex].size();
-        int end = match.second - backspace;
-        int start = end - utf8BannedWordLength + 1;
+Long texts are fed to the automaton in chunks of maskedRangesChunkUnits,
+`progress` (if given) is called after each one with the units done so far
+and cancels the search by returning false, the result is empty then. Made
+for background jobs, any thread may call it.
 
-        // Replace the range [start, end] with proper number of asterisks
-        stdStringText.erase(start, utf8BannedWordLength);
+returns: std::vector<std::pair<int, int>>
+*/
+std::vector<std::pair<int, int>> ProjectManager::findMaskedRanges(
+    QStringView text, const std::function<bool(qsizetype)>& progress) const {
+    return findMaskedRanges(currentBannedWords().get(), text, progress);
+}
 
-        // get the length of banned word
-        int actualBannedWordLength = QString::fromUtf8(bannedWordsLines[patternIndex].c_str()).length();
-        std::string replacementAsterisks(actualBannedWordLength, '*');
-        stdStringText.insert(start, replacementAsterisks);
-        
-        // update backspace
-        backspace += utf8BannedWordLength - actualBannedWordLength;
+/*
+Same as above on a given build, for jobs that must not touch the manager:
+they hold on to currentBannedWords() and may outlive it.
+*/
+std::vector<std::pair<int, int>> ProjectManager::findMaskedRanges(
+    const BannedWords* words, QStringView text, const std::function<bool(qsizetype)>& progress) {
+    static constexpr qsizetype maskedRangesChunkUnits = 256 * 1024;
+
+    std::vector<std::pair<int, int>> ranges;
+    if (!words || !words->automaton.usesTag(static_cast<int>(BannedWordsPolicy::Mask))) {
+        return ranges;
     }
-    QString filteredText = QString::fromStdString(stdStringText); 
 
-    return filteredText;
-}
+    const CompiledAhoCorasick& automaton = words->automaton;
+    CompiledAhoCorasick::SearchState state;
+    auto cover = [&](int patternIndex, qsizetype end) {
+        if (automaton.patternTag(patternIndex) != static_cast<int>(BannedWordsPolicy::Mask)) {
+            return;
+        }
+        int start = static_cast<int>(end) - automaton.patternLength(patternIndex) + 1;
+        int rangeEnd = static_cast<int>(end) + 1;
+        // a longer word may reach back over earlier ranges
+        while (!ranges.empty() && start <= ranges.back().second) {
+            start = std::min(start, ranges.back().first);
+            rangeEnd = std::max(rangeEnd, ranges.back().second);
+            ranges.pop_back();
+        }
+        ranges.push_back({start, rangeEnd});
+    };
 
-void ProjectManager::checkBannedWordsChanges() {
-    if (!isLoadedProject || currentProjectRoot.isEmpty()) {
-        return;
+    for (qsizetype done = 0; done < text.size(); ) {
+        qsizetype size = std::min(maskedRangesChunkUnits, text.size() - done);
+        automaton.scan(state, text.mid(done, size), cover);
+        done += size;
+        if (progress && !progress(done)) {
+            ranges.clear();
+            break;
+        }
     }
+    return ranges;
+}
 
-    // Step 1: Locate all .txt files
-    QDir directory(currentProjectRoot);
-    QStringList txtFiles = directory.entryList(QStringList() << "*.txt", QDir::Files);
+// Any thread may call it, the build stays valid as long as it is held
+std::shared_ptr<const BannedWords> ProjectManager::currentBannedWords() const {
+    return std::atomic_load(&bannedWords);
+}
 
-    // Step 2: Identify the file with the longest sequence of '*'
-    QString bestFile;
-    int maxStars = 0;
+/*
+Find the words of warn and highlight lists in `text`, for the highlighter.
+Masked words are left to matchBannedWords(). A word in both kinds of lists
+shows up once per list.
 
-    for (const QString& fileName : txtFiles) {
-        int starCount = fileName.count('*');
-        if (starCount > maxStars) {
-            maxStars = starCount;
-            bestFile = fileName;
-        }
+returns: std::vector<BannedWordHit>
+    hits ordered by end position
+*/
+std::vector<BannedWordHit> ProjectManager::findFlaggedWords(QStringView text) const {
+    std::vector<BannedWordHit> hits;
+    std::shared_ptr<const BannedWords> current = std::atomic_load(&bannedWords);
+    if (!current
+        || (!current->automaton.usesTag(static_cast<int>(BannedWordsPolicy::Warn))
+            && !current->automaton.usesTag(static_cast<int>(BannedWordsPolicy::Highlight)))) {
+        return hits;
     }
 
-    // If no banned words file found, return
-    if (bestFile.isEmpty()) {
-        if (haveBannedWordsFile) {
-            // We had a banned words file before, but now it's gone
-            haveBannedWordsFile = false;
-            bannedWordsLines.clear();
-            // Create a new empty trie
-            AhoCorasick trie;
-            bannedWordsTrie = trie;
-            maxiumBannedWordLength = 0;
+    const CompiledAhoCorasick& automaton = current->automaton;
+    CompiledAhoCorasick::SearchState state;
+    automaton.scan(state, text, [&](int patternIndex, qsizetype end) {
+        auto policy = static_cast<BannedWordsPolicy>(automaton.patternTag(patternIndex));
+        if (policy != BannedWordsPolicy::Mask) {
+            int length = automaton.patternLength(patternIndex);
+            hits.push_back({static_cast<int>(end) - length + 1, length, policy});
         }
-        return;
-    }
+    });
+    return hits;
+}
 
-    // Read the current contents of the file
-    QFile file(directory.filePath(bestFile));
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open file for checking changes:" << bestFile;
+/*
+Point the file watcher at the shared directories, their config file and the
+lists the last build used. Called between builds, so the build job is not
+writing bannedWordsLists meanwhile. Saving through a rename drops the old
+file from the watcher, adding it again picks up the new one.
+*/
+void ProjectManager::watchBannedWordsFiles() {
+    QStringList watched = bannedWordsFileWatcher->files() + bannedWordsFileWatcher->directories();
+    if (!watched.isEmpty()) {
+        bannedWordsFileWatcher->removePaths(watched);
+    }
+    if (currentProjectRoot.isEmpty()) {
         return;
     }
 
-    QTextStream in(&file);
-    std::vector<std::string> currentLines;
-    while (!in.atEnd()) {
-        QString line = in.readLine();
-        currentLines.push_back(line.toStdString());
+    QStringList paths;
+    paths << currentProjectRoot;
+    QString dirsFile = QDir(currentProjectRoot).filePath(".typrison/banned-words-dirs.txt");
+    if (QFileInfo::exists(dirsFile)) {
+        paths << dirsFile;
+    }
+    paths << bannedWordsDirs;
+    for (const BannedWordsList& list : bannedWordsLists) {
+        paths << list.path;
     }
-    file.close();
+    bannedWordsFileWatcher->addPaths(paths);
+}
 
-    // If this is the first time or the file has changed, update
-    if (!haveBannedWordsFile || currentLines != bannedWordsLines) {
-        
-        // Find removed lines
-        std::vector<std::string> removedLines;
-        for (const auto& oldLine : bannedWordsLines) {
-            if (std::find(currentLines.begin(), currentLines.end(), oldLine) == currentLines.end()) {
-                removedLines.push_back(oldLine);
-            }
-        }
-        
-        // Find new lines
-        std::vector<std::string> newLines;
-        for (const auto& newLine : currentLines) {
-            if (std::find(bannedWordsLines.begin(), bannedWordsLines.end(), newLine) == bannedWordsLines.end()) {
-                newLines.push_back(newLine);
-            }
-        }
-        
-        // Remove words that are no longer in the file
-        if (!removedLines.empty()) {
-            bannedWordsTrie.removeMultiple(removedLines);
-        }
-        
-        // Add new words to the trie
-        for (size_t i = 0; i < newLines.size(); ++i) {
-            // Find the index in the current lines
-            auto it = std::find(currentLines.begin(), currentLines.end(), newLines[i]);
-            if (it != currentLines.end()) {
-                int index = std::distance(currentLines.begin(), it);
-                bannedWordsTrie.insert(newLines[i], index);
-            }
-        }
-        
-        // If there were any changes, rebuild failure links
-        if (!removedLines.empty() || !newLines.empty()) {
-            bannedWordsTrie.buildFailureLinks();
-        }
-        
-        // Update the stored lines
-        bannedWordsLines = currentLines;
-        
-        // Recalculate maximum banned word length
-        maxiumBannedWordLength = 0;
-        for (const auto& str : bannedWordsLines) {
-            QString banneWordQSR = QString::fromUtf8(str.c_str());
-            maxiumBannedWordLength = std::max(static_cast<int>(banneWordQSR.length()), maxiumBannedWordLength);
-        }
-        
-        haveBannedWordsFile = true;
+void ProjectManager::checkBannedWordsChanges() {
+    if (!isLoadedProject || currentProjectRoot.isEmpty()) {
+        return;
     }
+    reloadBannedWords();
 }
 
+/*
+Find the wiki files of `projectRoot`: every .md file under wiki/, the ones
+directly in wiki/ first, or wiki.md in the root if there are none.
 
-void ProjectManager::readWikiFiles(const QString& selectedProjectRoot) {
-    QDir projectDir(selectedProjectRoot);
+returns: QStringList
+    file paths, empty if the project has no wiki
+*/
+QStringList ProjectManager::findWikiFiles(const QString& projectRoot) {
+    QDir projectDir(projectRoot);
     QDir wikiDir(projectDir.filePath("wiki"));
 
     QStringList mdFiles;
-    wikiContentMap.clear(); // Clear previous content
-    // wikiTrie.clear();
-
 
     // Check if the "wiki" directory exists
     if (wikiDir.exists()) {
-        // Use entryInfoList with QDir::AllEntries to get both files and directories
-        // Use QDir::NoDotAndDotDot to exclude "." and ".." entries
-        wikiDir.setFilter(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
-        wikiDir.setNameFilters(QStringList() << "*.md");
-        QFileInfoList entries = wikiDir.entryInfoList();
-        
-        // First, add all .md files in the current directory
-        for (const QFileInfo& entry : entries) {
-            if (entry.isFile()) {
-                mdFiles.append(entry.filePath());
-            }
+        // First, add all .md files in the wiki directory itself
+        QStringList rootFiles = wikiDir.entryList(QStringList() << "*.md", QDir::Files);
+        QSet<QString> seen;
+        for (const QString& fileName : rootFiles) {
+            mdFiles.append(wikiDir.filePath(fileName));
+            seen.insert(mdFiles.last());
         }
-        
+
         // Then recursively search subdirectories
-        QDirIterator it(wikiDir.path(), QStringList() << "*.md", QDir::Files, 
+        QDirIterator it(wikiDir.path(), QStringList() << "*.md", QDir::Files,
                         QDirIterator::Subdirectories);
         while (it.hasNext()) {
             QString filePath = it.next();
-            // Skip files already added from the root directory
-            if (!mdFiles.contains(filePath)) {
+            // Skip files already added from the wiki directory
+            if (!seen.contains(filePath)) {
                 mdFiles.append(filePath);
             }
         }
     }
 
     // If no .md files in "wiki", check for wiki.md in root
-    if (mdFiles.isEmpty()) {
-        QFile wikiFile(projectDir.filePath("wiki.md"));
-        if (wikiFile.exists()) {
-            mdFiles.append(projectDir.filePath("wiki.md"));
-        }
+    if (mdFiles.isEmpty() && QFile::exists(projectDir.filePath("wiki.md"))) {
+        mdFiles.append(projectDir.filePath("wiki.md"));
     }
+    return mdFiles;
+}
 
-    // If still no .md files, do nothing
-    if (mdFiles.isEmpty()) {
-        haveWiki = false;
+/*
+Start a wiki build on the thread pool, queued like reloadBannedWords().
+*/
+void ProjectManager::reloadWiki() {
+    if (wikiWatcher->isRunning()) {
+        wikiReloadPending = true;
         return;
     }
+    wikiReloadPending = false;
+
+    QString projectRoot = currentProjectRoot;
+    wikiWatcher->setFuture(QtConcurrent::run([this, projectRoot]() {
+        return rebuildWiki(projectRoot);
+    }));
+}
+
+/*
+Runs on a worker thread.
+
+Read and index the wiki files that changed since the last build, in
+parallel, merge the section titles of all files and publish them with a
+freshly compiled automaton as a new WikiIndex. A file is indexed again only
+if its size or time changed and then its contents did too. The index holds
+byte ranges into the files (see WikiSource), section text is only read
+by WikiIndex::content() when a popup needs it. Titles keep their
+pattern index across builds, like banned words, so the trie is only patched
+and the automaton is only recompiled when titles come or go.
+
+The first build for a project starts from .typrison/wiki.cache (see
+loadWikiCache()) and every new index is written back to it.
+
+returns: bool
+    true if a new index (or none) was published
+*/
+bool ProjectManager::rebuildWiki(const QString projectRoot) {
+    bool newProject = projectRoot != wikiProjectRoot;
+    if (newProject) {
+        // Another project, start over
+        wikiFiles.clear();
+        wikiTrie.clear();
+        wikiTrieMissing = false;
+        wikiPatternIndex.clear();
+        freeWikiPatternIndexes.clear();
+        wikiProjectRoot = projectRoot;
+    }
+    QStringList mdFiles = findWikiFiles(projectRoot);
 
-    haveWiki = true;
+    // If still no .md files, drop the current index
+    if (mdFiles.isEmpty()) {
+        wikiFiles.clear();
+        wikiTrie.clear();
+        wikiTrieMissing = false;
+        wikiPatternIndex.clear();
+        freeWikiPatternIndexes.clear();
+        if (std::atomic_load(&wikiIndex)) {
+            std::atomic_store(&wikiIndex, std::shared_ptr<const WikiIndex>());
+            return true;
+        }
+        return false;
+    }
 
-    // Process each markdown file
+    // Hover works from the cache while the files that changed are indexed
+    bool fromCache = newProject && loadWikiCache(projectRoot, mdFiles);
+    bool published = std::atomic_load(&wikiIndex) != nullptr;
+
+    // Same size and time as the last build, don't even open them
+    QStringList staleFiles;
     for (const QString& mdFile : mdFiles) {
-        QFile file(mdFile);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream in(&file);
-            QString content = in.readAll();
-            file.close();
-            
-            // Parse the markdown content to extract titles and sections
-            parseMarkdownContent(content, mdFile);
-            
+        auto known = wikiFiles.constFind(mdFile);
+        if (known == wikiFiles.cend()
+            || !AutomatonCache::statFingerprint(mdFile).sameStat((*known)->source())) {
+            staleFiles.append(mdFile);
+        }
+    }
+
+    // Read and index the rest concurrently, wikiFiles is only read meanwhile
+    std::vector<std::shared_ptr<const WikiSource>> openedFiles =
+        QtConcurrent::blockingMapped<std::vector<std::shared_ptr<const WikiSource>>>(
+            staleFiles, [this](const QString& mdFile) {
+                return WikiSource::open(mdFile, wikiFiles.value(mdFile).get());
+            });
+
+    bool changed = !published || (newProject && !fromCache);
+    for (qsizetype i = 0; i < staleFiles.size(); ++i) {
+        std::shared_ptr<const WikiSource>& opened = openedFiles[i];
+        if (!opened) {
+            qWarning() << "Could not open file:" << staleFiles[i];
+            changed = wikiFiles.remove(staleFiles[i]) > 0 || changed;
+            continue;
+        }
+        std::shared_ptr<const WikiSource> known = wikiFiles.value(staleFiles[i]);
+        changed = changed || !known || known->source().hash != opened->source().hash;
+        wikiFiles.insert(staleFiles[i], std::move(opened));
+    }
+
+    // Forget files that are gone
+    QSet<QString> present(mdFiles.cbegin(), mdFiles.cend());
+    for (auto it = wikiFiles.begin(); it != wikiFiles.end();) {
+        if (present.contains(it.key())) {
+            ++it;
         } else {
-            qWarning() << "Could not open file:" << mdFile;
+            it = wikiFiles.erase(it);
+            changed = true;
         }
     }
-    
-    // **Loop over `wikiContentMap` and insert section names into the Trie**
-    int index = 0;
-    for (const auto &section : wikiContentMap.keys()) {
-        wikiTrie.insert(section.toStdString(), index);
-        ++index;
+
+    if (!changed) {
+        return fromCache; // the index from the cache is up to date
     }
 
-    haveWiki = !wikiContentMap.isEmpty();
-}
+    // Titles keep their pattern index from build to build, gone titles leave a
+    // free slot that is reused by the next new one
+    std::shared_ptr<const WikiIndex> previous = std::atomic_load(&wikiIndex);
+    bool titlesChanged = !previous || (newProject && !fromCache);
+    std::shared_ptr<WikiIndex> build = mergeWikiSections(mdFiles, titlesChanged);
 
-void ProjectManager::parseMarkdownContent(const QString& content, const QString& filePath) {
-    QStringList lines = content.split('\n');
-    
-    // Create vectors to store titles and content at different levels (0-5 for h1-h6)
-    QVector<QString> currentTitles(6); // Array to store titles at different levels
-    QVector<QString> currentContents(6); // Array to store content at different levels
-    int newTitleLevel = 0;
-    bool isCodeBlock = false; // Flag to check if current block is a code block
-    
-    for (int i = 0; i < lines.size(); i++) {
-        QString line = lines[i];
-        
-        // Check if this line starts or ends a code block (```), toggle the flag
-        if (line.trimmed().startsWith("```")) {
-            isCodeBlock = !isCodeBlock;
-            
-            // Add this line to all active section contents
-            for (int j = 0; j < 6; j++) {
-                if (!currentTitles[j].isEmpty()) {
-                    currentContents[j] += line + "\n";
-                }
-            }
+    // Titles no section uses any more
+    for (auto it = wikiPatternIndex.begin(); it != wikiPatternIndex.end();) {
+        if (build->patternIndex.contains(it.key())) {
+            ++it;
             continue;
         }
-        
-        // If we're inside a code block, just add the line to all active sections
-        // and don't try to match it as a heading
-        if (isCodeBlock) {
-            for (int j = 0; j < 6; j++) {
-                if (!currentTitles[j].isEmpty()) {
-                    currentContents[j] += line + "\n";
-                }
-            }
+        ensureWikiTrie();
+        wikiTrie.removeWithoutRebuild(it.key(), it.value());
+        freeWikiPatternIndexes.push_back(it.value());
+        it = wikiPatternIndex.erase(it);
+        titlesChanged = true;
+    }
+
+    if (titlesChanged) {
+        ensureWikiTrie();
+        wikiTrie.buildFailureLinks();
+        // wiki is only searched on hover, keep the compact sparse form
+        build->automaton = CompiledAhoCorasick(wikiTrie, CompiledAhoCorasick::Mode::Sparse);
+    } else {
+        // Only section contents moved, the titles and their indexes are the same
+        build->automaton = previous->automaton;
+    }
+    build->trieBytes = wikiTrie.bytesUsed();
+
+    std::atomic_store(&wikiIndex, std::shared_ptr<const WikiIndex>(build));
+    saveWikiCache(projectRoot, *build);
+    return true;
+}
+
+/*
+Runs on a worker thread.
+
+Collect the sections of `mdFiles` by title into a new WikiIndex. Titles not
+seen before get a pattern index and go into wikiTrie, which sets
+`titlesChanged`. Titles that are gone are left to the caller.
+*/
+std::shared_ptr<WikiIndex> ProjectManager::mergeWikiSections(const QStringList& mdFiles, bool& titlesChanged) {
+    auto build = std::make_shared<WikiIndex>();
+    build->patterns.resize(wikiPatternIndex.size() + freeWikiPatternIndexes.size());
+    for (const QString& mdFile : mdFiles) {
+        std::shared_ptr<const WikiSource> source = wikiFiles.value(mdFile);
+        if (!source) {
             continue;
         }
-        
-        // Check if this line is a title (starts with # to ######)
-        QRegularExpression titleRegex("^(#{1,6})\\s+(.+)$");
-        QRegularExpressionMatch match = titleRegex.match(line);
-        
-        if (match.hasMatch()) {
-            // Extract the new title and its level
-            QString hashMarks = match.captured(1);
-            newTitleLevel = hashMarks.length() - 1;
-            QString newTitle = match.captured(2).trimmed();
-            
-            // If we already have content at or higher than the current level, save it
-            // equal or more hash marks
-            for (int j = newTitleLevel; j < 6; j++) {
-                if (!currentContents[j].isEmpty()) {
-                    // Trim any trailing whitespace from the content
-                    currentContents[j] = currentContents[j].trimmed();
-
-                    // Store the title and content in the map
-                    QString mapKey = currentTitles[j];
-                    if (wikiContentMap.contains(mapKey)) {
-                        // If key exists, append the new content
-                        wikiContentMap[mapKey] = wikiContentMap[mapKey] + "\n" + currentContents[j];
-                    } else {
-                        // If key doesn't exist, create new entry
-                        wikiContentMap[mapKey] = currentContents[j];
-                    }
-                    
-                    // Clear the title and content for this level
-                    currentTitles[j].clear();
-                    currentContents[j].clear();
+        int sourceIndex = static_cast<int>(build->sources.size());
+        build->sources.push_back(source);
+        const std::vector<WikiSection>& sections = source->sections();
+        for (size_t k = 0; k < sections.size(); ++k) {
+            const QString& title = sections[k].title;
+            auto known = wikiPatternIndex.constFind(title);
+            int index;
+            if (known != wikiPatternIndex.cend()) {
+                index = known.value();
+            } else {
+                if (freeWikiPatternIndexes.empty()) {
+                    index = static_cast<int>(build->patterns.size());
+                    build->patterns.emplace_back();
+                } else {
+                    index = freeWikiPatternIndexes.back();
+                    freeWikiPatternIndexes.pop_back();
                 }
+                ensureWikiTrie();
+                wikiPatternIndex.insert(title, index);
+                wikiTrie.insert(title, index);
+                titlesChanged = true;
             }
-
-            for (int j = 0; j < newTitleLevel; j++) {
-                if (!currentTitles[j].isEmpty()) {
-                    currentContents[j] += line + "\n";
-                }
+            WikiIndex::Pattern& pattern = build->patterns[index];
+            if (pattern.sections.empty()) {
+                pattern.title = title;
+                pattern.length = title.length();
+                build->patternIndex.insert(title, index);
             }
-            
-            // Update the current title level and set the new title
-            currentTitles[newTitleLevel] = newTitle;
-            
-            // Clear any existing content at this level
-            currentContents[newTitleLevel].clear();
-            currentContents[newTitleLevel] += line + "\n";
+            // Sections with the same title are joined in file order
+            pattern.sections.emplace_back(sourceIndex, static_cast<int>(k));
+        }
+    }
+    return build;
+}
+
+// Runs on a worker thread, put the titles of a cached index into wikiTrie
+void ProjectManager::ensureWikiTrie() {
+    if (!wikiTrieMissing) {
+        return;
+    }
+    wikiTrieMissing = false;
+    for (auto it = wikiPatternIndex.cbegin(); it != wikiPatternIndex.cend(); ++it) {
+        wikiTrie.insert(it.key(), it.value());
+    }
+}
+
+QString ProjectManager::wikiCachePath(const QString& projectRoot) {
+    return QDir(projectRoot).filePath(".typrison/wiki.cache");
+}
+
+/*
+Runs on a worker thread, for a project's first wiki build.
+
+Take the wiki index from .typrison/wiki.cache: files that still have the
+size and time they were cached with get their sections back without being
+read, titles get their old pattern indexes and the cached automaton is
+published right away. Files that changed or are new are left to the rest
+of rebuildWiki().
+
+The cached automaton is only published if it still fits: no cached file
+was deleted and every title in it still has a section. Otherwise it would
+report titles nothing can be shown for, so the caller compiles a new one.
+
+returns: bool
+    true if an index was published
+*/
+bool ProjectManager::loadWikiCache(const QString& projectRoot, const QStringList& mdFiles) {
+    CompiledAhoCorasick automaton;
+    QByteArray metadata;
+    if (!AutomatonCache::load(wikiCachePath(projectRoot), automaton, metadata)) {
+        return false;
+    }
+
+    struct CachedFile {
+        QString path;
+        SourceFingerprint source;
+        std::vector<WikiSection> sections;
+    };
+    std::vector<CachedFile> cachedFiles;
+    QStringList titles;
+
+    QDir projectDir(projectRoot);
+    QSet<QString> present(mdFiles.cbegin(), mdFiles.cend());
+    bool filesMissing = false;
+    QDataStream in(metadata);
+    in.setVersion(QDataStream::Qt_5_15);
+    quint32 fileCount = 0;
+    in >> fileCount;
+    for (quint32 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+        CachedFile cached;
+        quint32 sectionCount = 0;
+        in >> cached.path >> cached.source.size >> cached.source.modified >> cached.source.hash >> sectionCount;
+        for (quint32 k = 0; k < sectionCount && in.status() == QDataStream::Ok; ++k) {
+            WikiSection section;
+            qint32 level = 0;
+            qint32 parent = 0;
+            in >> section.title >> section.begin >> section.end >> level >> parent;
+            section.level = level;
+            section.parent = parent;
+            cached.sections.push_back(std::move(section));
+        }
+        cached.path = projectDir.filePath(cached.path);
+        if (present.contains(cached.path)) {
+            cachedFiles.push_back(std::move(cached));
         } else {
-            // If we have a current title, add this line to its content
-            for (int j = 0; j < 6; j++) {
-                if (!currentTitles[j].isEmpty()) {
-                    currentContents[j] += line + "\n";
-                }
-            }
+            filesMissing = true; // its titles are still in the automaton
         }
     }
+    in >> titles;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
 
-    // Don't forget to add the last sections
-    for (int j = 0; j < 6; j++) {
-        if (!currentTitles[j].isEmpty()) {
-            currentContents[j] = currentContents[j].trimmed();
-            // QString mapKey = filePath + "::" + currentTitles[j];
-            QString mapKey = currentTitles[j];
+    // Files that did not change are not even opened
+    std::vector<std::shared_ptr<const WikiSource>> openedFiles =
+        QtConcurrent::blockingMapped<std::vector<std::shared_ptr<const WikiSource>>>(
+            cachedFiles, [](const CachedFile& cached) {
+                return WikiSource::open(cached.path, cached.source, cached.sections);
+            });
+    for (size_t i = 0; i < cachedFiles.size(); ++i) {
+        if (openedFiles[i]) {
+            wikiFiles.insert(cachedFiles[i].path, std::move(openedFiles[i]));
+        }
+    }
 
-            if (wikiContentMap.contains(mapKey)) {
-                // If key exists, append the new content
-                wikiContentMap[mapKey] = wikiContentMap[mapKey] + "\n" + currentContents[j];
-            } else {
-                // If key doesn't exist, create new entry
-                wikiContentMap[mapKey] = currentContents[j];
-            }
+    // The trie itself is only needed once titles change, see ensureWikiTrie()
+    for (int index = 0; index < titles.size(); ++index) {
+        const QString& title = titles[index];
+        if (title.isEmpty() || wikiPatternIndex.contains(title)) {
+            freeWikiPatternIndexes.push_back(index);
+            continue;
+        }
+        wikiPatternIndex.insert(title, index);
+    }
+    wikiTrieMissing = true;
+
+    // The cached automaton only fits if every title kept its index and still
+    // has a section, a file that changed since may have dropped some
+    bool titlesChanged = false;
+    std::shared_ptr<WikiIndex> build = mergeWikiSections(mdFiles, titlesChanged);
+    if (titlesChanged || filesMissing) {
+        return false;
+    }
+    for (auto it = wikiPatternIndex.cbegin(); it != wikiPatternIndex.cend(); ++it) {
+        if (build->patterns[it.value()].sections.empty()) {
+            return false;
         }
     }
+    build->automaton = automaton;
+    build->trieBytes = wikiTrie.bytesUsed();
+    std::atomic_store(&wikiIndex, std::shared_ptr<const WikiIndex>(std::move(build)));
+    return true;
+}
+
+/*
+Runs on a worker thread. Write `index` to .typrison/wiki.cache, file paths
+relative to the project so the cache survives moving the project.
+*/
+void ProjectManager::saveWikiCache(const QString& projectRoot, const WikiIndex& index) {
+    QByteArray metadata;
+    QDataStream out(&metadata, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+
+    QDir projectDir(projectRoot);
+    out << static_cast<quint32>(index.sources.size());
+    for (const auto& source : index.sources) {
+        const std::vector<WikiSection>& sections = source->sections();
+        out << projectDir.relativeFilePath(source->path()) << source->source().size
+            << source->source().modified << source->source().hash << static_cast<quint32>(sections.size());
+        for (const WikiSection& section : sections) {
+            out << section.title << section.begin << section.end
+                << static_cast<qint32>(section.level) << static_cast<qint32>(section.parent);
+        }
+    }
+
+    // Pattern index -> title, empty for a free index
+    QStringList titles;
+    for (const WikiIndex::Pattern& pattern : index.patterns) {
+        titles.append(pattern.title);
+    }
+    out << titles;
+
+    AutomatonCache::save(wikiCachePath(projectRoot), index.automaton, metadata);
+}
+
+void ProjectManager::onWikiRebuilt() {
+    std::shared_ptr<const WikiIndex> current = std::atomic_load(&wikiIndex);
+    haveWiki = current && !current->patternIndex.isEmpty();
+    if (wikiWatcher->result()) {
+        emit wikiChanged();
+    }
+    if (wikiReloadPending) {
+        reloadWiki();
+    }
 }
 
-// Add this method after readWikiFiles
+QString WikiIndex::content(const QString& title) const {
+    QString content;
+    auto found = patternIndex.constFind(title);
+    if (found == patternIndex.cend()) {
+        return content;
+    }
+    for (const auto& section : patterns[found.value()].sections) {
+        const WikiSource& source = *sources[section.first];
+        if (!content.isEmpty()) {
+            content += "\n";
+        }
+        content += source.text(source.sections()[section.second]);
+    }
+    return content;
+}
 
 void ProjectManager::printWikiContent() {
-    if (!haveWiki || wikiContentMap.isEmpty()) {
+    std::shared_ptr<const WikiIndex> current = std::atomic_load(&wikiIndex);
+    if (!current || current->patternIndex.isEmpty()) {
         return;
     }
     
     qDebug() << "=== Wiki Content Debug ===";
-    // Iterate through all keys in the map
-    for (auto it = wikiContentMap.constBegin(); it != wikiContentMap.constEnd(); ++it) {
+    // Iterate through all titles, skipping unused pattern indexes
+    for (const WikiIndex::Pattern& pattern : current->patterns) {
+        if (pattern.title.isEmpty()) {
+            continue;
+        }
         // Print the key
-        qDebug() << "Key:" << it.key();
+        qDebug() << "Key:" << pattern.title;
         
         // Print a preview of the content (first 100 chars)
-        QString contentPreview = it.value();
+        QString contentPreview = current->content(pattern.title);
         if (contentPreview.length() > 100) {
             contentPreview = contentPreview.left(100) + "...";
         }
@@ -467,47 +1000,27 @@ void ProjectManager::printWikiContent() {
 QMap<QString, QList<QPair<int, QString>>> ProjectManager::matchWikiContent(const QString& text) {
     QMap<QString, QList<QPair<int, QString>>> matches;
 
-    if (!haveWiki || wikiContentMap.isEmpty()) {
+    // Hold on to the current index, a rebuild may publish a new one meanwhile
+    std::shared_ptr<const WikiIndex> current = std::atomic_load(&wikiIndex);
+    if (!current || current->patternIndex.isEmpty()) {
         return matches;
     }
 
-    // Create a mapping from UTF-8 positions to QString positions
-    QByteArray utf8Text = text.toUtf8();
-    QVector<int> positionMap;
-    positionMap.reserve(utf8Text.size() + 1);
-    
-    // Build the position mapping
-    int qstringPos = 0;
-    for (int i = 0; i < text.length(); ++i) {
-        QByteArray charUtf8 = text.mid(i, 1).toUtf8();
-        for (int j = 0; j < charUtf8.size(); ++j) {
-            positionMap.append(i);
-        }
-        qstringPos++;
-    }
-    // Add one more for the end position
-    positionMap.append(text.length());
-    
-    // Convert QString to std::string for AhoCorasick
-    std::string stdStringText = text.toStdString();
-    
-    // Get matches from the trie
-    std::vector<std::pair<int, int>> trieMatches = wikiTrie.search(stdStringText);
+    // Get matches from the trie, positions are QString positions
+    std::vector<std::pair<int, int>> trieMatches = current->automaton.search(QStringView(text));
     
     // Process matches
     for (const auto& match : trieMatches) {
         int patternIndex = match.first;  // Index of the matched pattern
-        int utf8Position = match.second;  // Position in the UTF-8 text where match ends
-        
-        // Map the UTF-8 position back to QString position
-        int qstringPosition = (utf8Position < positionMap.size()) ? positionMap[utf8Position] : text.length() - 1;
+        int qstringPosition = match.second;  // Position in the text where match ends
         
-        // Get the wiki content key from the pattern index
-        QString wikiKey = wikiContentMap.keys()[patternIndex];
+        // The pattern table holds the wiki content key and its length
+        const WikiIndex::Pattern& pattern = current->patterns[patternIndex];
+        const QString& wikiKey = pattern.title;
         
         // Get the matched text
-        QString matchedText = wikiContentMap.keys()[patternIndex];
-        int matchLength = matchedText.length();
+        const QString& matchedText = pattern.title;
+        int matchLength = pattern.length;
         int startPos = qstringPosition - matchLength + 1;
         
         // Ensure startPos is not negative
@@ -529,12 +1042,14 @@ QString ProjectManager::getContentByKeys(QList<QString> matchedWikiKeys) {
     QString content;
     
     // Check if we have any wiki content
-    if (!haveWiki || wikiContentMap.isEmpty()) {
+    std::shared_ptr<const WikiIndex> current = std::atomic_load(&wikiIndex);
+    if (!current || current->patternIndex.isEmpty()) {
         return content;
     }
     
     for (const auto& wikiKey : matchedWikiKeys) {
-        content += "--------------------------\n" + wikiContentMap[wikiKey];
+        // Keys from an older index may be gone by now
+        content += "--------------------------\n" + current->content(wikiKey);
     }
     return content;
 }
\ No newline at end of file
@@ -2,11 +2,70 @@
 #define PROJECTMANAGER_H
 
 #include "utils/ahocorasick.h"
+#include "utils/automatoncache.h"
+#include "utils/compiledahocorasick.h"
+#include "utils/wikisource.h"
 #include <QDir>
 #include <QFile>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMap>
 #include <QObject>
+#include <QSet>
 #include <QTimer>
-#include <unordered_set>
+#include <functional>
+#include <memory>
+
+/*
+What happens to the words of one banned words list, taken from its file
+name: "***.txt" masks, "***.warn.txt" underlines, "***.highlight.txt" paints
+the background. Also the pattern tag in the compiled automaton.
+*/
+enum class BannedWordsPolicy : quint8 {
+    Mask = 0,
+    Warn = 1,
+    Highlight = 2
+};
+
+// A word of a warn or highlight list found in a text, in QString positions
+struct BannedWordHit {
+    int start;
+    int length;
+    BannedWordsPolicy policy;
+};
+
+/*
+One immutable build of all banned words lists, merged.
+
+A build is published as a whole through std::atomic_store, readers grab it
+with std::atomic_load and keep using their copy until they are done, even if
+a newer build is published meanwhile.
+*/
+struct BannedWords {
+    CompiledAhoCorasick automaton;      // also knows every word's length and policy
+    size_t trieBytes = 0;               // size of the mutable trie it came from, 0 if cached
+};
+
+/*
+One immutable build of the wiki, published the same way as BannedWords.
+*/
+struct WikiIndex {
+    // One title of the wiki, what a pattern index of the automaton stands for
+    struct Pattern {
+        QString title;                              // empty for an unused index
+        int length = 0;                             // in QChars, as matched
+        std::vector<std::pair<int, int>> sections;  // (source, section) in file order
+    };
+
+    std::vector<std::shared_ptr<const WikiSource>> sources;
+    std::vector<Pattern> patterns;      // pattern index -> title, stable across builds
+    QHash<QString, int> patternIndex;   // title -> pattern index
+    CompiledAhoCorasick automaton;
+    size_t trieBytes = 0;
+
+    QString content(const QString& title) const; // sections joined by "\n", empty if unknown
+};
 
 class ProjectManager : public QObject {
     Q_OBJECT  // Required macro for QObject subclasses
@@ -14,12 +73,19 @@ class ProjectManager : public QObject {
 public:
     // Constructor
     explicit ProjectManager(QObject* parent = nullptr);
+    ~ProjectManager();
 
     // Member Functions
     void open(const QString selectedProjectRoot);
     QString matchBannedWords(QString text);
+    std::vector<BannedWordHit> findFlaggedWords(QStringView text) const; // warn + highlight lists
+    std::vector<std::pair<int, int>> findMaskedRanges(
+        QStringView text, const std::function<bool(qsizetype)>& progress = nullptr) const;
+    static std::vector<std::pair<int, int>> findMaskedRanges(
+        const BannedWords* words, QStringView text, const std::function<bool(qsizetype)>& progress = nullptr);
+    std::shared_ptr<const BannedWords> currentBannedWords() const; // the published build, null if none
     int getMaxiumBannedWordLength();
-    void parseMarkdownContent(const QString& content, const QString& filePath);
+    size_t bytesUsed() const; // memory held by the banned words and wiki automata
     void printWikiContent(); // New method to print wiki content
     QMap<QString, QList<QPair<int, QString>>> matchWikiContent(const QString& keyword);
     QString getContentByKeys(QList<QString> matchedWikiKeys);
@@ -28,22 +94,67 @@ public:
     bool haveBannedWordsFile;
     bool haveWiki;
     bool isLoadedProject;
-    
+
+signals:
+    void bannedWordsChanged(); // a new build was published
+    void wikiChanged();        // same for the wiki
+
 private:
+    // One banned words file, only touched by the build job
+    struct BannedWordsList {
+        QString path;
+        BannedWordsPolicy policy;
+        SourceFingerprint source;
+        QHash<QString, int> words;      // word -> pattern index
+    };
+
     // Member Variables
-    std::vector<std::string> bannedWordsLines;
+    std::shared_ptr<const BannedWords> bannedWords; // use std::atomic_load/atomic_store
+    // Only touched by the banned words build job, one job runs at a time
+    std::vector<BannedWordsList> bannedWordsLists;
+    std::vector<quint8> bannedWordsTags;        // pattern index -> policy
+    std::vector<int> freeBannedWordsIndexes;    // slots left by removed words
     AhoCorasick bannedWordsTrie;
-    AhoCorasick wikiTrie;
-    int maxiumBannedWordLength;
-    QTimer* bannedWordsTimer;
+    QString bannedWordsProjectRoot;
+    QStringList bannedWordsDirs;                // shared directories of the last build
+    bool bannedWordsFromCache;                  // trie is empty, the build came from disk
+    QFileSystemWatcher* bannedWordsFileWatcher; // project root, shared directories, lists
+    QTimer* bannedWordsTimer;                   // debounces watcher signals
+    QFutureWatcher<bool>* bannedWordsWatcher;
+    bool bannedWordsReloadPending;
     QString currentProjectRoot;
-    QMap<QString, QString> wikiContentMap; // Key: filePath::title, Value: content
+    std::shared_ptr<const WikiIndex> wikiIndex; // use std::atomic_load/atomic_store
+    // Only touched by the wiki build job
+    QHash<QString, std::shared_ptr<const WikiSource>> wikiFiles; // file path -> last parse
+    AhoCorasick wikiTrie;
+    QHash<QString, int> wikiPatternIndex;       // title -> pattern index in wikiTrie
+    std::vector<int> freeWikiPatternIndexes;    // slots left by removed titles
+    bool wikiTrieMissing;                       // loaded from the cache, see ensureWikiTrie()
+    QString wikiProjectRoot;
+    QFutureWatcher<bool>* wikiWatcher;
+    bool wikiReloadPending;
 
-    void readBannedWords(const QString selectedProjectRoot);
-    void readWikiFiles(const QString& selectedProjectRoot);
+    static QStringList readBannedWordsDirs(const QString& projectRoot);
+    static std::vector<std::pair<QString, BannedWordsPolicy>> findBannedWordsFiles(
+        const QString& projectRoot, const QStringList& sharedDirs);
+    void reloadBannedWords();
+    bool rebuildBannedWords(const QString projectRoot);
+    void clearBannedWords();
+    void removeBannedWordsList(BannedWordsList& list);
+    static QStringList findWikiFiles(const QString& projectRoot);
+    void reloadWiki();
+    bool rebuildWiki(const QString projectRoot);
+    std::shared_ptr<WikiIndex> mergeWikiSections(const QStringList& mdFiles, bool& titlesChanged);
+    void ensureWikiTrie();
+    static QString wikiCachePath(const QString& projectRoot);
+    bool loadWikiCache(const QString& projectRoot, const QStringList& mdFiles);
+    void saveWikiCache(const QString& projectRoot, const WikiIndex& index);
     
 private slots:
     void checkBannedWordsChanges();
+    void watchBannedWordsFiles();
+    void onBannedWordsRebuilt();
+    void onWikiRebuilt();
 };
 
 #endif // PROJECTMANAGER_H
@@ -0,0 +1,124 @@
+#include "utils/ahocorasick.h"
+#include "utils/compiledahocorasick.h"
+
+#include <QString>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+/*
+Readers searching while a writer keeps publishing new automata, the way
+ProjectManager shares its banned words and wiki builds: a build is
+immutable, published with std::atomic_store and grabbed with
+std::atomic_load, and a reader keeps using its copy even after a newer one
+is out.
+
+Every build knows how many matches its own search of the text gives, so a
+reader that sees a half-published or freed build gets a wrong count (or
+crashes). Readers also search the shared mutable trie, whose search() is
+const. Build with -fsanitize=thread to have data races reported too.
+
+usage: automatonstresstest [readers, default 8] [builds, default 100]
+*/
+namespace {
+struct Build {
+    CompiledAhoCorasick automaton;
+    int generation = 0;
+    size_t matches = 0;     // search(text).size() on the writer thread
+};
+
+QString randomWord(std::mt19937& rng) {
+    std::uniform_int_distribution<int> length(2, 6);
+    std::uniform_int_distribution<int> letter('a', 'z');
+    QString word;
+    for (int n = length(rng); n > 0; --n) {
+        word += QChar(static_cast<char16_t>(letter(rng)));
+    }
+    return word;
+}
+
+std::shared_ptr<const Build> makeBuild(int generation, const QString& text) {
+    std::mt19937 rng(generation);
+    AhoCorasick trie;
+    for (int i = 0, count = 50 + generation % 200; i < count; ++i) {
+        trie.insert(randomWord(rng), i);
+    }
+    trie.buildFailureLinks();
+
+    auto build = std::make_shared<Build>();
+    // Alternate the modes, both have to be safe to share
+    build->automaton = CompiledAhoCorasick(
+        trie, generation % 2 ? CompiledAhoCorasick::Mode::Dfa : CompiledAhoCorasick::Mode::Sparse);
+    build->generation = generation;
+    build->matches = build->automaton.search(QStringView(text)).size();
+    return build;
+}
+}
+
+int main(int argc, char* argv[]) {
+    int readers = argc > 1 ? std::atoi(argv[1]) : 8;
+    int builds = argc > 2 ? std::atoi(argv[2]) : 100;
+
+    std::mt19937 rng(1);
+    QString text;
+    while (text.size() < 300000) {
+        text += randomWord(rng);
+        text += QChar(u' ');
+    }
+
+    AhoCorasick sharedTrie;
+    for (int i = 0; i < 500; ++i) {
+        sharedTrie.insert(randomWord(rng), i);
+    }
+    sharedTrie.buildFailureLinks();
+    const size_t sharedMatches = sharedTrie.search(QStringView(text)).size();
+
+    std::shared_ptr<const Build> published = makeBuild(0, text);
+    std::atomic<bool> done(false);
+    std::atomic<int> failures(0);
+    std::atomic<long> searches(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&, r]() {
+            int round = 0;
+            while (!done.load()) {
+                std::shared_ptr<const Build> current = std::atomic_load(&published);
+                QStringView view(text);
+                if (round % 4 == 0) {
+                    // A copy grabbed before a republish stays usable
+                    std::this_thread::yield();
+                }
+                size_t matches = round % 3 == 0 ? current->automaton.searchParallel(view).size()
+                                                : current->automaton.search(view).size();
+                if (matches != current->matches) {
+                    std::fprintf(stderr, "reader %d: build %d gave %zu matches, expected %zu\n",
+                                 r, current->generation, matches, current->matches);
+                    ++failures;
+                }
+                if (round % 5 == 0 && sharedTrie.search(view).size() != sharedMatches) {
+                    std::fprintf(stderr, "reader %d: shared trie gave a different result\n", r);
+                    ++failures;
+                }
+                ++searches;
+                ++round;
+            }
+        });
+    }
+
+    for (int generation = 1; generation <= builds && failures.load() == 0; ++generation) {
+        std::atomic_store(&published, makeBuild(generation, text));
+    }
+    done = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::printf("%d readers, %d builds, %ld searches, %d failures\n",
+                readers, builds, searches.load(), failures.load());
+    return failures.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include "fictiontextedit.h"
+#include "utils/segmentedtext.h"
+
+#include <QAbstractTextDocumentLayout>
+#include <QApplication>
+#include <QHash>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <cmath>
+#include <cstdio>
+
+/*
+Paged mode only makes the document's first block the manuscript's title
+while the window starts at the first segment. A paragraph that becomes the
+top of a later window has to keep the size and the height it had further
+down, or the segment heights measured from the layout (and with them the
+scroll position) drift every time the window moves.
+
+The manuscript is long enough for paged mode and every paragraph is
+unique. Searching for the first paragraph of segment 2 shows segments 1..3,
+so segment 1's first paragraph, in the window before too, becomes the top.
+
+Swapping segments must not lose the undo history either: an edit scrolled
+out of the window is still undone and redone.
+
+usage: pagedmodetest
+*/
+namespace {
+qreal pointSize(const QTextBlock& block) {
+    QTextCursor cursor(block);
+    cursor.movePosition(QTextCursor::NextCharacter);
+    return cursor.charFormat().font().pointSizeF();
+}
+
+qreal height(const QTextBlock& block) {
+    return block.document()->documentLayout()->blockBoundingRect(block).height();
+}
+}
+
+int main(int argc, char* argv[]) {
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication app(argc, argv);
+
+    QString text;
+    for (int line = 0; text.size() < 1300000; ++line) {
+        if (line > 0) {
+            text += QLatin1Char('\n');
+        }
+        text += QString::asprintf("paragraph %06d ", line);
+        text += QString(90, QLatin1Char('x'));
+    }
+    std::vector<QString> pieces = SegmentedText::split(text);
+    if (pieces.size() < 6) {
+        std::fprintf(stderr, "expected at least 6 segments, got %zu\n", pieces.size());
+        return 1;
+    }
+
+    FictionTextEdit edit(nullptr, nullptr, nullptr);
+    edit.resize(1000, 800);
+    edit.show();
+    QApplication::processEvents();
+    edit.load(text);
+
+    int failures = 0;
+    QTextBlock title = edit.document()->firstBlock();
+    if (title.text() != pieces[0].section(QLatin1Char('\n'), 0, 0) || height(title) <= height(title.next())) {
+        std::fprintf(stderr, "the manuscript should open with its title on top\n");
+        ++failures;
+    }
+
+    // sizes and heights of the paragraphs while segment 0 is on top
+    QHash<QString, std::pair<qreal, qreal>> before;
+    for (QTextBlock block = edit.document()->firstBlock(); block.isValid(); block = block.next()) {
+        before.insert(block.text(), {pointSize(block), height(block)});
+    }
+
+    edit.search(pieces[2].section(QLatin1Char('\n'), 0, 0));
+
+    QTextBlock top = edit.document()->firstBlock();
+    if (top.text() != pieces[1].section(QLatin1Char('\n'), 0, 0) || !before.contains(top.text())) {
+        std::fprintf(stderr, "expected segment 1 on top of the window, got \"%s\"\n",
+                     qPrintable(top.text().left(20)));
+        return 1;
+    }
+    auto [size, blockHeight] = before.value(top.text());
+    if (pointSize(top) != size) {
+        std::fprintf(stderr, "top paragraph is %.1fpt, was %.1fpt\n", pointSize(top), size);
+        ++failures;
+    }
+    if (std::abs(height(top) - blockHeight) > 0.5) {
+        std::fprintf(stderr, "top paragraph is %.1f high, was %.1f\n", height(top), blockHeight);
+        ++failures;
+    }
+
+    // an edit (over the search match) survives scrolling it out of the
+    // window: undo brings it back
+    QTextCursor cursor = edit.textCursor();
+    cursor.insertText(QStringLiteral("typed "));
+    edit.search(pieces.back().section(QLatin1Char('\n'), 0, 0));
+    if (edit.document()->toPlainText().contains(QStringLiteral("typed "))) {
+        std::fprintf(stderr, "expected the edit to be swapped out of the window\n");
+        ++failures;
+    }
+    edit.undo();
+    if (edit.fullText() != text) {
+        std::fprintf(stderr, "undo after scrolling away did not restore the manuscript\n");
+        ++failures;
+    }
+    edit.redo();
+    if (!edit.fullText().contains(QStringLiteral("typed "))) {
+        std::fprintf(stderr, "redo did not bring the edit back\n");
+        ++failures;
+    }
+
+    std::printf("%d segments, %d failures\n", static_cast<int>(pieces.size()), failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -1,104 +1,262 @@
 #include "ahocorasick.h"
 
-AhoCorasick::AhoCorasick() {
-    root = new TrieNode();
+#include <queue>
+
+namespace {
+const quint64 emptyEdge = ~quint64(0);
+const quint64 removedEdge = ~quint64(0) - 1;
+
+quint64 edgeKey(int node, char16_t unit) {
+    return (static_cast<quint64>(node) << 16) | unit;
+}
+
+size_t edgeSlot(quint64 key, size_t mask) {
+    // Fibonacci hashing, spreads neighbouring nodes over the table
+    return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 17) & mask;
+}
+}
+
+AhoCorasick::AhoCorasick()
+    : nodes(1)
+    , edges(16, Edge{emptyEdge, -1})
+    , usedEdges(0)
+{
 }
 
-void AhoCorasick::insert(const std::string& word, int index) {
-    TrieNode* curr = root;
-    for (char c : word) {
-        if (!curr->children.count(c)) {
-            curr->children[c] = new TrieNode();
+void AhoCorasick::clear() {
+    *this = AhoCorasick();
+}
+
+size_t AhoCorasick::bytesUsed() const {
+    return sizeof(*this)
+           + nodes.capacity() * sizeof(TrieNode)
+           + freeNodes.capacity() * sizeof(int)
+           + ownOutputs.capacity() * sizeof(OutputEntry)
+           + freeOutputs.capacity() * sizeof(int)
+           + edges.capacity() * sizeof(Edge);
+}
+
+int AhoCorasick::child(int node, char16_t unit) const {
+    quint64 key = edgeKey(node, unit);
+    size_t mask = edges.size() - 1;
+    for (size_t slot = edgeSlot(key, mask); ; slot = (slot + 1) & mask) {
+        if (edges[slot].key == key) {
+            return edges[slot].child;
+        }
+        if (edges[slot].key == emptyEdge) {
+            return -1;
         }
-        curr = curr->children[c];
     }
-    curr->output.push_back(index);
 }
 
-void AhoCorasick::buildFailureLinks() {
-    std::queue<TrieNode*> q;
-    for (auto& [c, child] : root->children) {
-        child->failLink = root;
-        q.push(child);
+void AhoCorasick::addChild(int node, char16_t unit, int childNode) {
+    // Keep at most 3/4 of the slots used, tombstones included. Every node
+    // but the root hangs on one edge; only grow if those fill half the table.
+    if ((usedEdges + 1) * 4 > edges.size() * 3) {
+        size_t liveEdges = nodes.size() - freeNodes.size() - 1;
+        rehashEdges(liveEdges * 2 > edges.size() ? edges.size() * 2 : edges.size());
     }
+
+    quint64 key = edgeKey(node, unit);
+    size_t mask = edges.size() - 1;
+    size_t slot = edgeSlot(key, mask);
+    while (edges[slot].key != emptyEdge && edges[slot].key != removedEdge) {
+        slot = (slot + 1) & mask;
+    }
+    if (edges[slot].key == emptyEdge) {
+        ++usedEdges;
+    }
+    edges[slot] = Edge{key, childNode};
+
+    nodes[childNode].nextSibling = nodes[node].firstChild;
+    nodes[node].firstChild = childNode;
+}
+
+void AhoCorasick::removeChild(int node, char16_t unit) {
+    quint64 key = edgeKey(node, unit);
+    size_t mask = edges.size() - 1;
+    int childNode = -1;
+    for (size_t slot = edgeSlot(key, mask); edges[slot].key != emptyEdge; slot = (slot + 1) & mask) {
+        if (edges[slot].key == key) {
+            childNode = edges[slot].child;
+            edges[slot] = Edge{removedEdge, -1};
+            break;
+        }
+    }
+    if (childNode < 0) {
+        return;
+    }
+
+    // Unlink from the sibling list
+    int* link = &nodes[node].firstChild;
+    while (*link != childNode) {
+        link = &nodes[*link].nextSibling;
+    }
+    *link = nodes[childNode].nextSibling;
+}
+
+void AhoCorasick::rehashEdges(size_t capacity) {
+    std::vector<Edge> oldEdges(capacity, Edge{emptyEdge, -1});
+    oldEdges.swap(edges);
+    usedEdges = 0;
+
+    size_t mask = edges.size() - 1;
+    for (const Edge& edge : oldEdges) {
+        if (edge.key == emptyEdge || edge.key == removedEdge) {
+            continue;
+        }
+        size_t slot = edgeSlot(edge.key, mask);
+        while (edges[slot].key != emptyEdge) {
+            slot = (slot + 1) & mask;
+        }
+        edges[slot] = edge;
+        ++usedEdges;
+    }
+}
+
+int AhoCorasick::allocateNode(char16_t unit) {
+    TrieNode node;
+    node.unit = unit;
+    if (!freeNodes.empty()) {
+        int index = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[index] = node;
+        return index;
+    }
+    nodes.push_back(node);
+    return static_cast<int>(nodes.size()) - 1;
+}
+
+void AhoCorasick::insert(QStringView word, int index) {
+    int curr = 0;
+    for (QChar ch : word) {
+        char16_t c = ch.unicode();
+        int next = child(curr, c);
+        if (next < 0) {
+            next = allocateNode(c);
+            addChild(curr, c, next);
+        }
+        curr = next;
+    }
+
+    OutputEntry entry{index, nodes[curr].ownOutputHead};
+    if (!freeOutputs.empty()) {
+        nodes[curr].ownOutputHead = freeOutputs.back();
+        freeOutputs.pop_back();
+        ownOutputs[nodes[curr].ownOutputHead] = entry;
+    } else {
+        nodes[curr].ownOutputHead = static_cast<int>(ownOutputs.size());
+        ownOutputs.push_back(entry);
+    }
+}
+
+void AhoCorasick::buildFailureLinks() {
+    std::queue<int> q;
+    q.push(0);
     while (!q.empty()) {
-        TrieNode* curr = q.front();
+        int curr = q.front();
         q.pop();
 
-        for (auto& [c, child] : curr->children) {
-            TrieNode* fail = curr->failLink;
-            while (fail && !fail->children.count(c)) {
-                fail = fail->failLink;
+        for (int next = nodes[curr].firstChild; next >= 0; next = nodes[next].nextSibling) {
+            char16_t c = nodes[next].unit;
+            int target = 0;
+            if (curr != 0) {
+                int fail = nodes[curr].failLink;
+                while (true) {
+                    int candidate = child(fail, c);
+                    if (candidate >= 0) {
+                        target = candidate;
+                        break;
+                    }
+                    if (fail == 0) {
+                        break;
+                    }
+                    fail = nodes[fail].failLink;
+                }
             }
-            child->failLink = fail ? fail->children[c] : root;
-            child->output.insert(child->output.end(),
-                                 child->failLink->output.begin(),
-                                 child->failLink->output.end());
-            q.push(child);
+            nodes[next].failLink = target;
+
+            // The fail target is shallower, its output link is already set
+            nodes[next].outputLink = nodes[target].ownOutputHead >= 0 ? target : nodes[target].outputLink;
+            q.push(next);
         }
     }
 }
 
-std::vector<std::pair<int, int>> AhoCorasick::search(const std::string& text) {
-    TrieNode* curr = root;
+std::vector<std::pair<int, int>> AhoCorasick::search(QStringView text) const {
+    int curr = 0;
     std::vector<std::pair<int, int>> result;
     for (int i = 0; i < text.size(); i++) {
-        char c = text[i];
-        while (curr && !curr->children.count(c)) {
-            curr = curr->failLink;
+        char16_t c = text[i].unicode();
+        int next = child(curr, c);
+        while (next < 0 && curr != 0) {
+            curr = nodes[curr].failLink;
+            next = child(curr, c);
         }
-        curr = curr ? curr->children[c] : root;
-        for (int index : curr->output) {
-            result.push_back(std::make_pair(index, i));
+        curr = next < 0 ? 0 : next;
+
+        // Own words first, then the shorter ones along the output links
+        for (int node = curr; node >= 0; node = nodes[node].outputLink) {
+            for (int entry = nodes[node].ownOutputHead; entry >= 0; entry = ownOutputs[entry].next) {
+                result.push_back(std::make_pair(ownOutputs[entry].index, i));
+            }
         }
     }
     return result;
 }
 
-void AhoCorasick::remove(const std::string& word) {
+void AhoCorasick::remove(QStringView word) {
     removeWithoutRebuild(word);
     // Rebuild failure links as they might be affected
     buildFailureLinks();
 }
 
-void AhoCorasick::removeWithoutRebuild(const std::string& word) {
-    TrieNode* curr = root;
-    std::vector<std::pair<TrieNode*, char>> path;
-    
+void AhoCorasick::removeWithoutRebuild(QStringView word, int index) {
+    int curr = 0;
+    std::vector<int> path;
+
     // Traverse to the end of the word
-    for (char c : word) {
-        if (!curr->children.count(c)) {
+    for (QChar ch : word) {
+        int next = child(curr, ch.unicode());
+        if (next < 0) {
             return; // Word not found
         }
-        path.push_back({curr, c});
-        curr = curr->children[c];
-    }
-    
-    // Clear all indices from output
-    curr->output.clear();
-    
-    // If node has no children, remove it and its parents if possible
-    if (curr->children.empty()) {
-        for (int i = path.size() - 1; i >= 0; i--) {
-            TrieNode* parent = path[i].first;
-            char c = path[i].second;
-            TrieNode* child = parent->children[c];
-            
-            delete child;
-            parent->children.erase(c);
-            
+        path.push_back(curr);
+        curr = next;
+    }
+
+    // Clear the matching indices from output
+    int* link = &nodes[curr].ownOutputHead;
+    while (*link >= 0) {
+        int entry = *link;
+        if (index < 0 || ownOutputs[entry].index == index) {
+            *link = ownOutputs[entry].next;
+            freeOutputs.push_back(entry);
+        } else {
+            link = &ownOutputs[entry].next;
+        }
+    }
+
+    // If node has no children and no output left, remove it and its parents if possible
+    if (nodes[curr].firstChild < 0 && nodes[curr].ownOutputHead < 0) {
+        for (int i = static_cast<int>(path.size()) - 1; i >= 0; i--) {
+            int parent = path[i];
+            removeChild(parent, nodes[curr].unit);
+            freeNodes.push_back(curr);
+
             // Stop if parent has other children or is an output node
-            if (!parent->children.empty() || !parent->output.empty()) {
+            if (nodes[parent].firstChild >= 0 || nodes[parent].ownOutputHead >= 0) {
                 break;
             }
+            curr = parent;
         }
     }
 }
 
-void AhoCorasick::removeMultiple(const std::vector<std::string>& words) {
+void AhoCorasick::removeMultiple(const std::vector<QString>& words) {
     for (const auto& word : words) {
         removeWithoutRebuild(word);
     }
     // Rebuild failure links only once after all removals
     buildFailureLinks();
-}
\ No newline at end of file
+}
@@ -1,40 +1,95 @@
 #ifndef AHOCORASICK_H
 #define AHOCORASICK_H
 
-#include <unordered_map>
 #include <vector>
-#include <queue>
 #include <string>
 #include <QDebug>
+#include <QString>
+#include <QStringView>
 
+/*
+Trie keyed on UTF-16 code units, so QString text is matched as it is and
+match positions are QString positions.
+
+A node only stores the words ending exactly there. The words that end at
+the same place but are shorter (suffixes) are reached by following
+outputLink, so a list where many words are suffixes of each other does
+not copy outputs into every node.
+
+All nodes live in one arena (`nodes`) and refer to each other by index,
+children are found through one open-addressing edge table. Nothing owns
+heap memory of its own, so dropping the whole trie frees a handful of
+vectors instead of walking the node graph.
+
+Concurrency: search() and bytesUsed() only read, any number of threads may
+call them at once. insert(), remove*(), clear() and buildFailureLinks()
+need exclusive access, so build a trie on one thread and only share it
+once it is done (ProjectManager publishes a new compiled copy instead of
+editing a shared one).
+*/
 struct TrieNode {
-    std::unordered_map<char, TrieNode*> children;
-    TrieNode* failLink = nullptr;
-    std::vector<int> output; // Store indexes of strings ending here
+    char16_t unit = 0;          // code unit on the edge from the parent
+    int firstChild = -1;
+    int nextSibling = -1;
+    int failLink = 0;
+    int outputLink = -1;        // nearest node on the fail chain with outputs
+    int ownOutputHead = -1;     // list in AhoCorasick::ownOutputs
 };
 
 class AhoCorasick {
-    TrieNode* root;
+    friend class CompiledAhoCorasick;
 
 public:
     AhoCorasick();
-    // ~AhoCorasick();
+
+    // Move only, the arena is not shared
+    AhoCorasick(const AhoCorasick&) = delete;
+    AhoCorasick& operator=(const AhoCorasick&) = delete;
+    AhoCorasick(AhoCorasick&&) noexcept = default;
+    AhoCorasick& operator=(AhoCorasick&&) noexcept = default;
 
     // Insert a string into the Trie
-    void insert(const std::string& word, int index);
+    void insert(QStringView word, int index);
+
+    void remove(QStringView word);
+    void removeMultiple(const std::vector<QString>& words);
+    // Drop `index` from the outputs of `word`, every index if it is negative
+    void removeWithoutRebuild(QStringView word, int index = -1);
 
-    void remove(const std::string& word);
-    void removeMultiple(const std::vector<std::string>& words);
-    void removeWithoutRebuild(const std::string& word);
+    // Drop every word, releases the arena in one go
+    void clear();
 
     // Build failure links using BFS
     void buildFailureLinks();
 
-    // Search the text for patterns
-    std::vector<std::pair<int, int>> search(const std::string& text);
+    // Search the text for patterns, read-only
+    std::vector<std::pair<int, int>> search(QStringView text) const;
+
+    size_t bytesUsed() const;
 
 private:
-    void deleteTrie(TrieNode* node); // Helper to clean up memory
+    struct OutputEntry {
+        int index;
+        int next;
+    };
+
+    struct Edge {
+        quint64 key;            // parent << 16 | unit
+        int child;
+    };
+
+    int child(int node, char16_t unit) const;
+    void addChild(int node, char16_t unit, int childNode);
+    void removeChild(int node, char16_t unit);
+    void rehashEdges(size_t capacity);
+    int allocateNode(char16_t unit);
+
+    std::vector<TrieNode> nodes;        // node 0 is the root
+    std::vector<int> freeNodes;
+    std::vector<OutputEntry> ownOutputs;
+    std::vector<int> freeOutputs;
+    std::vector<Edge> edges;            // open addressing, size is a power of two
+    size_t usedEdges;                   // live edges + tombstones
 };
 
-#endif // AHOCORASICK_H
\ No newline at end of file
+#endif // AHOCORASICK_H
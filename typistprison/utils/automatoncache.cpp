@@ -0,0 +1,156 @@
+#include "automatoncache.h"
+
+#include <cstring>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+const char cacheMagic[8] = {'T', 'P', 'C', 'A', 'C', 'H', 'E', '\0'};
+const quint32 cacheVersion = 3;
+
+// 96 bytes, keeps the blob behind it 8-byte aligned in the mapping
+struct CacheHeader {
+    char magic[8];
+    quint32 version;
+    quint32 metadataSize;   // bytes after the blob
+    qint64 sourceSize;
+    qint64 sourceModified;
+    char sourceHash[32];
+    char blobHash[32];      // SHA-256 of the blob, the source hash doesn't cover it
+};
+static_assert(sizeof(CacheHeader) == 96, "CacheHeader must stay 96 bytes");
+
+// Map `file` and hand the blob to `automaton`, copy the metadata out
+bool loadFile(std::shared_ptr<QFile> file, const CacheHeader& header,
+              CompiledAhoCorasick& automaton, QByteArray* metadata) {
+    qint64 blobSize = file->size() - static_cast<qint64>(sizeof(CacheHeader)) - header.metadataSize;
+    if (blobSize < 0) {
+        return false;
+    }
+
+    // The mapping lives as long as the file object, which the automaton holds on to
+    uchar* mapped = file->map(sizeof(CacheHeader), blobSize + header.metadataSize);
+    if (!mapped) {
+        return false;
+    }
+    const char* blob = reinterpret_cast<const char*>(mapped);
+    // A torn write or a damaged disk, attach() only checks the structure
+    QByteArray blobHash = QCryptographicHash::hash(
+        QByteArray::fromRawData(blob, static_cast<int>(blobSize)), QCryptographicHash::Sha256);
+    if (std::memcmp(header.blobHash, blobHash.constData(), sizeof(header.blobHash)) != 0) {
+        return false;
+    }
+    if (metadata) {
+        *metadata = QByteArray(blob + blobSize, header.metadataSize);
+    }
+    return CompiledAhoCorasick::fromBlob(file, blob, blobSize, automaton);
+}
+
+bool readHeader(QFile& file, CacheHeader& header) {
+    return file.open(QIODevice::ReadOnly)
+           && file.size() >= static_cast<qint64>(sizeof(CacheHeader))
+           && file.read(reinterpret_cast<char*>(&header), sizeof(header)) == sizeof(header)
+           && std::memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) == 0
+           && header.version == cacheVersion;
+}
+
+bool writeFile(const QString& cachePath, const SourceFingerprint& source,
+               const CompiledAhoCorasick& automaton, const QByteArray& metadata) {
+    if (source.hash.size() != sizeof(CacheHeader::sourceHash)
+        || !QDir().mkpath(QFileInfo(cachePath).absolutePath())) {
+        return false;
+    }
+
+    CacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+    header.version = cacheVersion;
+    header.metadataSize = static_cast<quint32>(metadata.size());
+    header.sourceSize = source.size;
+    header.sourceModified = source.modified;
+    std::memcpy(header.sourceHash, source.hash.constData(), sizeof(header.sourceHash));
+    QByteArray blob = automaton.blob();
+    QByteArray blobHash = QCryptographicHash::hash(blob, QCryptographicHash::Sha256);
+    std::memcpy(header.blobHash, blobHash.constData(), sizeof(header.blobHash));
+
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write automaton cache:" << cachePath;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(blob.constData(), blob.size());
+    file.write(metadata.constData(), metadata.size());
+    return file.commit();
+}
+}
+
+bool SourceFingerprint::sameStat(const SourceFingerprint& other) const {
+    return size == other.size && modified == other.modified;
+}
+
+bool SourceFingerprint::operator==(const SourceFingerprint& other) const {
+    return sameStat(other) && hash == other.hash;
+}
+
+SourceFingerprint AutomatonCache::statFingerprint(const QString& sourcePath) {
+    SourceFingerprint source;
+    QFileInfo info(sourcePath);
+    if (info.exists()) {
+        source.size = info.size();
+        source.modified = info.lastModified().toMSecsSinceEpoch();
+    }
+    return source;
+}
+
+SourceFingerprint AutomatonCache::fingerprint(const QString& sourcePath, const QByteArray& contents) {
+    SourceFingerprint source = statFingerprint(sourcePath);
+    source.hash = QCryptographicHash::hash(contents, QCryptographicHash::Sha256);
+    return source;
+}
+
+bool AutomatonCache::load(const QString& cachePath, const SourceFingerprint& source,
+                          CompiledAhoCorasick& automaton) {
+    auto file = std::make_shared<QFile>(cachePath);
+    CacheHeader header;
+    if (!readHeader(*file, header)
+        || header.metadataSize != 0
+        || header.sourceSize != source.size
+        || header.sourceModified != source.modified
+        || source.hash.size() != sizeof(header.sourceHash)
+        || std::memcmp(header.sourceHash, source.hash.constData(), sizeof(header.sourceHash)) != 0) {
+        return false;
+    }
+    return loadFile(file, header, automaton, nullptr);
+}
+
+bool AutomatonCache::load(const QString& cachePath, CompiledAhoCorasick& automaton, QByteArray& metadata) {
+    auto file = std::make_shared<QFile>(cachePath);
+    CacheHeader header;
+    if (!readHeader(*file, header)
+        || header.sourceSize != header.metadataSize
+        || !loadFile(file, header, automaton, &metadata)) {
+        return false;
+    }
+    // The hash in the header covers the metadata
+    QByteArray hash = QCryptographicHash::hash(metadata, QCryptographicHash::Sha256);
+    return std::memcmp(header.sourceHash, hash.constData(), sizeof(header.sourceHash)) == 0;
+}
+
+bool AutomatonCache::save(const QString& cachePath, const SourceFingerprint& source,
+                          const CompiledAhoCorasick& automaton) {
+    return writeFile(cachePath, source, automaton, QByteArray());
+}
+
+bool AutomatonCache::save(const QString& cachePath, const CompiledAhoCorasick& automaton,
+                          const QByteArray& metadata) {
+    SourceFingerprint source;
+    source.size = metadata.size();
+    source.hash = QCryptographicHash::hash(metadata, QCryptographicHash::Sha256);
+    return writeFile(cachePath, source, automaton, metadata);
+}
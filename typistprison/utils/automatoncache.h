@@ -0,0 +1,54 @@
+#ifndef AUTOMATONCACHE_H
+#define AUTOMATONCACHE_H
+
+#include "compiledahocorasick.h"
+
+#include <QByteArray>
+#include <QString>
+
+/*
+Identifies one version of a source file (e.g. the banned words list).
+*/
+struct SourceFingerprint {
+    qint64 size = -1;
+    qint64 modified = 0;    // last modification, ms since epoch
+    QByteArray hash;        // SHA-256 of the contents
+
+    // Size and time only, cheap enough to poll
+    bool sameStat(const SourceFingerprint& other) const;
+    bool operator==(const SourceFingerprint& other) const;
+};
+
+/*
+Compiled automata cached on disk, so a project opens without re-reading
+and re-compiling its word lists.
+
+A cache file is a small header naming the source it was built from
+(size, modification time, content hash) followed by the automaton blob
+(see CompiledAhoCorasick::blob()). load() maps the file, checks the blob
+against its SHA-256 in the header and uses it in place. Anything that does not match, from another format version
+or byte order to a different source, makes load() return false and the
+caller builds as usual. save() replaces the file atomically.
+
+An automaton built from many files (e.g. the wiki) can instead carry
+`metadata` after the blob, describing its sources in whatever form the
+caller likes; the caller checks them itself and the header only vouches
+for the metadata being intact.
+*/
+class AutomatonCache
+{
+public:
+    static SourceFingerprint fingerprint(const QString& sourcePath, const QByteArray& contents);
+    static SourceFingerprint statFingerprint(const QString& sourcePath); // without hash
+
+    static bool load(const QString& cachePath, const SourceFingerprint& source,
+                     CompiledAhoCorasick& automaton);
+    static bool save(const QString& cachePath, const SourceFingerprint& source,
+                     const CompiledAhoCorasick& automaton);
+
+    static bool load(const QString& cachePath, CompiledAhoCorasick& automaton, QByteArray& metadata);
+    static bool save(const QString& cachePath, const CompiledAhoCorasick& automaton,
+                     const QByteArray& metadata);
+};
+
+#endif // AUTOMATONCACHE_H
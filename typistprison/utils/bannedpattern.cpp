@@ -0,0 +1,218 @@
+#include "bannedpattern.h"
+
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+// One character or class with its repeat count
+struct Atom {
+    QStringList choices;    // a surrogate pair is one choice
+    int minCount = 1;
+    int maxCount = 1;
+};
+
+bool isMetaCharacter(QChar ch) {
+    return QStringView(u"\\/[]?{}*+.()|^$").contains(ch);
+}
+
+// Read one character at `i`, escaped or not, a surrogate pair as a whole
+bool readCharacter(QStringView body, qsizetype& i, QString& character, bool& escaped) {
+    escaped = body[i] == QLatin1Char('\\');
+    if (escaped && ++i == body.size()) {
+        return false;
+    }
+    qsizetype length = 1;
+    if (body[i].isHighSurrogate() && i + 1 < body.size() && body[i + 1].isLowSurrogate()) {
+        length = 2;
+    }
+    character = body.mid(i, length).toString();
+    i += length;
+    return true;
+}
+
+/*
+`[...]` starting at `i`, which points past the '['. A class of more than
+`maxLiterals` characters expands to more than that many words anyway, so it
+is refused before a wide range like `[一-龥]` is listed.
+*/
+bool readClass(QStringView body, qsizetype& i, QStringList& choices, int maxLiterals) {
+    while (i < body.size() && body[i] != QLatin1Char(']')) {
+        QString first;
+        bool escaped;
+        if (!readCharacter(body, i, first, escaped)) {
+            return false;
+        }
+        bool isRange = i + 1 < body.size() && body[i] == QLatin1Char('-') && body[i + 1] != QLatin1Char(']');
+        if (!isRange) {
+            if (!choices.contains(first)) {
+                choices.append(first);
+            }
+            if (choices.size() > maxLiterals) {
+                return false;
+            }
+            continue;
+        }
+
+        ++i; // '-'
+        QString last;
+        if (!readCharacter(body, i, last, escaped) || first.size() != 1 || last.size() != 1
+            || first[0] > last[0]) {
+            return false;
+        }
+        // int, a range ending at U+FFFF would wrap a char16_t round to 0
+        int firstUnit = first[0].unicode();
+        int lastUnit = last[0].unicode();
+        int surrogates = std::max(0, std::min(lastUnit, 0xdfff) - std::max(firstUnit, 0xd800) + 1);
+        if (lastUnit - firstUnit + 1 - surrogates > maxLiterals) {
+            return false;
+        }
+        for (int unit = firstUnit; unit <= lastUnit; ++unit) {
+            QChar character(static_cast<char16_t>(unit));
+            if (!character.isSurrogate() && !choices.contains(QString(character))) {
+                choices.append(QString(character));
+            }
+        }
+        if (choices.size() > maxLiterals) {
+            return false;
+        }
+    }
+    if (i == body.size() || choices.isEmpty()) {
+        return false;
+    }
+    ++i; // ']'
+    return true;
+}
+
+// `{n}` or `{m,n}` starting at `i`, which points past the '{'
+bool readRepeat(QStringView body, qsizetype& i, Atom& atom) {
+    qsizetype close = body.indexOf(QLatin1Char('}'), i);
+    if (close < 0) {
+        return false;
+    }
+    QStringView counts = body.mid(i, close - i);
+    qsizetype comma = counts.indexOf(QLatin1Char(','));
+    bool minOk = false;
+    bool maxOk = false;
+    if (comma < 0) {
+        atom.minCount = counts.toInt(&minOk);
+        atom.maxCount = atom.minCount;
+        maxOk = minOk;
+    } else {
+        atom.minCount = counts.left(comma).toInt(&minOk);
+        atom.maxCount = counts.mid(comma + 1).toInt(&maxOk);
+    }
+    i = close + 1;
+    return minOk && maxOk && atom.minCount >= 0 && atom.minCount <= atom.maxCount
+           && atom.maxCount >= 1 && atom.maxCount <= BannedPattern::maxRepeat;
+}
+
+bool parse(QStringView body, std::vector<Atom>& atoms, int maxLiterals) {
+    qsizetype i = 0;
+    while (i < body.size()) {
+        Atom atom;
+        if (body[i] == QLatin1Char('[')) {
+            ++i;
+            if (!readClass(body, i, atom.choices, maxLiterals)) {
+                return false;
+            }
+        } else {
+            // An operator with nothing to apply to, or one we don't support
+            if (isMetaCharacter(body[i]) && body[i] != QLatin1Char('\\')) {
+                return false;
+            }
+            QString character;
+            bool escaped;
+            if (!readCharacter(body, i, character, escaped)) {
+                return false;
+            }
+            atom.choices.append(character);
+        }
+
+        if (i < body.size() && body[i] == QLatin1Char('?')) {
+            atom.minCount = 0;
+            ++i;
+        } else if (i < body.size() && body[i] == QLatin1Char('{')) {
+            ++i;
+            if (!readRepeat(body, i, atom)) {
+                return false;
+            }
+        }
+        atoms.push_back(std::move(atom));
+    }
+    return true;
+}
+}
+
+bool BannedPattern::isPattern(QStringView line) {
+    return line.size() > 2 && line.startsWith(QLatin1Char('/')) && line.endsWith(QLatin1Char('/'));
+}
+
+/*
+Expand the pattern `line` into the words it matches.
+
+The count is worked out before anything is built, so a pattern like
+`/[a-z]{8}/` is refused right away instead of running out of memory.
+*/
+bool BannedPattern::expand(QStringView line, std::vector<QString>& literals, int maxLiterals) {
+    if (!isPattern(line)) {
+        return false;
+    }
+    std::vector<Atom> atoms;
+    if (!parse(line.mid(1, line.size() - 2), atoms, maxLiterals)) {
+        return false;
+    }
+
+    // Literal count is the product over atoms of sum(choices^count)
+    qint64 total = 1;
+    for (const Atom& atom : atoms) {
+        qint64 variants = 0;
+        qint64 power = 1;
+        for (int count = 0; count <= atom.maxCount; ++count) {
+            if (count >= atom.minCount) {
+                variants += power;
+            }
+            power *= atom.choices.size();
+            if (power > maxLiterals || variants > maxLiterals) {
+                power = qint64(maxLiterals) + 1;
+            }
+        }
+        total *= std::min<qint64>(variants, qint64(maxLiterals) + 1);
+        if (total > maxLiterals) {
+            return false;
+        }
+    }
+
+    std::vector<QString> current(1);
+    for (const Atom& atom : atoms) {
+        std::vector<QString> next;
+        // All words of `count` repeats, built up one repeat at a time
+        std::vector<QString> repeats(1);
+        for (int count = 0; count <= atom.maxCount; ++count) {
+            if (count >= atom.minCount) {
+                for (const QString& prefix : current) {
+                    for (const QString& repeat : repeats) {
+                        next.push_back(prefix + repeat);
+                    }
+                }
+            }
+            if (count == atom.maxCount) {
+                break;
+            }
+            std::vector<QString> longer;
+            for (const QString& repeat : repeats) {
+                for (const QString& choice : atom.choices) {
+                    longer.push_back(repeat + choice);
+                }
+            }
+            repeats = std::move(longer);
+        }
+        current = std::move(next);
+    }
+
+    for (QString& literal : current) {
+        if (!literal.isEmpty()) {
+            literals.push_back(std::move(literal));
+        }
+    }
+    return true;
+}
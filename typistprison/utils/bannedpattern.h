@@ -0,0 +1,38 @@
+#ifndef BANNEDPATTERN_H
+#define BANNEDPATTERN_H
+
+#include <QString>
+#include <QStringView>
+#include <vector>
+
+/*
+Patterns in banned words lists, for spelling variants.
+
+A line between slashes, like `/f[u*]{1,3}c ?k/`, is a pattern instead of a
+word. The syntax is a small part of regular expressions:
+- `[abc]`, `[a-z]`: one character out of a class
+- `x?`: optional character or class
+- `x{n}`, `x{m,n}`: bounded repeat, n at most maxRepeat
+- `\x`: `x` itself, for any of `\ / [ ] ? { } * + . ( ) | ^ $ -`
+
+Everything a pattern matches is bounded, so expand() simply lists every
+literal it stands for. The literals go into the same automaton as the
+plain words and a scan stays one pass, whatever the pattern count.
+Patterns that would expand to more than `maxLiterals` words are rejected.
+*/
+class BannedPattern
+{
+public:
+    static constexpr int maxRepeat = 16;
+    static constexpr int defaultMaxLiterals = 1024;
+
+    static bool isPattern(QStringView line);
+
+    // Append every non-empty literal `line` matches to `literals`, the same
+    // literal may come more than once. Returns false, appending nothing, for
+    // a syntax error or too many literals.
+    static bool expand(QStringView line, std::vector<QString>& literals,
+                       int maxLiterals = defaultMaxLiterals);
+};
+
+#endif // BANNEDPATTERN_H
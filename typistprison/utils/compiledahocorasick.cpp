@@ -0,0 +1,650 @@
+#include "compiledahocorasick.h"
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <QThreadPool>
+#include <qtconcurrentmap.h>
+
+namespace {
+const quint32 blobMagic = 0x43415054; // "TPAC"
+const quint32 blobVersion = 3; // 3: Dfa automata skip from the root too
+const quint32 blobByteOrder = 0x01020304;
+
+enum BlobSection {
+    ClassPagesSection,
+    StatesSection,
+    TransitionClassesSection,
+    TransitionTargetsSection,
+    OutputsSection,
+    DfaTransitionsSection,
+    PatternLengthsSection,
+    PatternTagsSection,
+    RootUnitsSection,
+    SectionCount
+};
+
+struct BlobHeader {
+    quint32 magic;
+    quint32 version;
+    quint32 byteOrder;      // blobByteOrder as the writing machine stores it
+    quint32 mode;
+    qint32 longestPattern;
+    qint32 classStride;
+    quint32 skipFromRoot;
+    quint32 tagsUsed;
+    quint16 classPageIndex[256];
+    quint64 sectionOffset[SectionCount];
+    quint64 sectionCount[SectionCount];
+};
+
+const size_t sectionItemSizes[SectionCount] = {
+    sizeof(unsigned short),     // class pages
+    6 * sizeof(int),            // states
+    sizeof(unsigned short),     // transition classes
+    sizeof(int),                // transition targets
+    sizeof(int),                // outputs
+    sizeof(int),                // dfa transitions
+    sizeof(int),                // pattern lengths
+    sizeof(quint8),             // pattern tags
+    sizeof(char16_t)            // root units
+};
+
+// Every array starts 8-byte aligned inside the blob
+qsizetype alignedSize(qsizetype bytes) {
+    return (bytes + 7) & ~qsizetype(7);
+}
+}
+
+/*
+The arrays while they are being built, packed into one blob by adopt().
+*/
+struct CompiledAhoCorasick::Build {
+    Mode mode = Mode::Sparse;
+    int longestPattern = 0;
+    int classStride = 1;
+    std::array<unsigned short, 256> classPageIndex{};
+    std::vector<unsigned short> classPages = std::vector<unsigned short>(256, 0);
+    std::vector<State> states;
+    std::vector<unsigned short> transitionClasses;
+    std::vector<int> transitionTargets;
+    std::vector<int> outputs;
+    std::vector<int> dfaTransitions;
+    std::vector<int> patternLengths;
+    std::vector<quint8> patternTags;
+    quint32 tagsUsed = 0;
+    std::vector<char16_t> rootUnits;
+    bool skipFromRoot = false;
+
+    unsigned short unitClass(char16_t unit) const {
+        return classPages[classPageIndex[unit >> 8] * 256 + (unit & 0xff)];
+    }
+
+    void buildDfa();
+};
+
+CompiledAhoCorasick::CompiledAhoCorasick()
+    : blobData(nullptr)
+    , blobSize(0)
+    , currentMode(Mode::Sparse)
+    , longestPatternLength(0)
+    , classStride(1)
+    , tagsUsed(0)
+    , skipFromRoot(false)
+{
+    classPageIndex.fill(0);
+}
+
+/*
+Flatten `trie` into contiguous arrays.
+
+The trie must already have its failure links built. Only the words ending
+exactly at a state are copied, the rest is reached through outputLink.
+*/
+CompiledAhoCorasick::CompiledAhoCorasick(const AhoCorasick& trie, Mode mode,
+                                         const std::vector<quint8>& patternTags)
+    : CompiledAhoCorasick()
+{
+    Build build;
+
+    // Number the nodes in BFS order so that a state and its children
+    // end up close to each other in memory
+    const std::vector<TrieNode>& nodes = trie.nodes;
+    std::vector<int> order;
+    std::vector<int> ids(nodes.size(), -1);
+    std::vector<int> depths(1, 0);
+    order.push_back(0);
+    ids[0] = 0;
+
+    std::vector<char16_t> usedUnits;
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (int child = nodes[order[i]].firstChild; child >= 0; child = nodes[child].nextSibling) {
+            usedUnits.push_back(nodes[child].unit);
+            ids[child] = static_cast<int>(order.size());
+            order.push_back(child);
+            depths.push_back(depths[i] + 1);
+        }
+    }
+    std::sort(usedUnits.begin(), usedUnits.end());
+    usedUnits.erase(std::unique(usedUnits.begin(), usedUnits.end()), usedUnits.end());
+
+    // Units that never appear in a pattern share class 0, page 0 is all zeros
+    unsigned short classCount = 0;
+    for (char16_t unit : usedUnits) {
+        unsigned short& page = build.classPageIndex[unit >> 8];
+        if (page == 0) {
+            page = static_cast<unsigned short>(build.classPages.size() / 256);
+            build.classPages.resize(build.classPages.size() + 256, 0);
+        }
+        build.classPages[page * 256 + (unit & 0xff)] = ++classCount;
+    }
+    build.classStride = classCount + 1;
+
+    build.states.reserve(order.size());
+    build.transitionClasses.reserve(order.size());
+    build.transitionTargets.reserve(order.size());
+
+    for (int child = nodes[0].firstChild; child >= 0; child = nodes[child].nextSibling) {
+        build.rootUnits.push_back(nodes[child].unit);
+    }
+    build.skipFromRoot = true;
+
+    std::vector<std::pair<unsigned short, int>> edges;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const TrieNode& node = nodes[order[i]];
+        State state;
+        state.failLink = ids[node.failLink];
+        state.outputLink = node.outputLink >= 0 ? ids[node.outputLink] : -1;
+
+        edges.clear();
+        for (int child = node.firstChild; child >= 0; child = nodes[child].nextSibling) {
+            edges.emplace_back(build.unitClass(nodes[child].unit), ids[child]);
+        }
+        std::sort(edges.begin(), edges.end());
+
+        state.transitionBegin = static_cast<int>(build.transitionClasses.size());
+        for (const auto& [edgeClass, target] : edges) {
+            build.transitionClasses.push_back(edgeClass);
+            build.transitionTargets.push_back(target);
+        }
+        state.transitionEnd = static_cast<int>(build.transitionClasses.size());
+
+        state.outputBegin = static_cast<int>(build.outputs.size());
+        for (int entry = node.ownOutputHead; entry >= 0; entry = trie.ownOutputs[entry].next) {
+            int patternIndex = trie.ownOutputs[entry].index;
+            build.outputs.push_back(patternIndex);
+            if (patternIndex >= static_cast<int>(build.patternLengths.size())) {
+                build.patternLengths.resize(patternIndex + 1, 0);
+                build.patternTags.resize(patternIndex + 1, 0);
+            }
+            build.patternLengths[patternIndex] = depths[i];
+            if (patternIndex < static_cast<int>(patternTags.size())) {
+                build.patternTags[patternIndex] = patternTags[patternIndex] & 31;
+            }
+            build.tagsUsed |= 1u << build.patternTags[patternIndex];
+            build.longestPattern = std::max(build.longestPattern, depths[i]);
+        }
+        state.outputEnd = static_cast<int>(build.outputs.size());
+
+        build.states.push_back(state);
+    }
+
+    if (mode == Mode::Dfa) {
+        size_t tableBytes = build.states.size() * build.classStride * sizeof(int);
+        if (tableBytes <= maxDfaBytes) {
+            build.buildDfa();
+        } else {
+            qWarning() << "AhoCorasick DFA table too large (" << tableBytes
+                       << "bytes ), keeping sparse transitions";
+        }
+    }
+
+    adopt(build);
+}
+
+/*
+Resolve the goto function for every (state, unit class) pair.
+
+States are in BFS order and a failure link always points to a shallower
+state, so the row of the fail target is complete when a state is filled.
+*/
+void CompiledAhoCorasick::Build::buildDfa() {
+    dfaTransitions.assign(states.size() * classStride, 0);
+
+    for (size_t s = 0; s < states.size(); ++s) {
+        const State& current = states[s];
+        int* row = &dfaTransitions[s * classStride];
+        if (s != 0) {
+            const int* failRow = &dfaTransitions[current.failLink * classStride];
+            std::copy(failRow, failRow + classStride, row);
+        }
+        for (int k = current.transitionBegin; k < current.transitionEnd; ++k) {
+            row[transitionClasses[k]] = transitionTargets[k];
+        }
+    }
+    mode = Mode::Dfa;
+}
+
+/*
+Copy `build` into one freshly allocated blob and point the arrays at it.
+*/
+void CompiledAhoCorasick::adopt(const Build& build) {
+    BlobHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = blobMagic;
+    header.version = blobVersion;
+    header.byteOrder = blobByteOrder;
+    header.mode = static_cast<quint32>(build.mode);
+    header.longestPattern = build.longestPattern;
+    header.classStride = build.classStride;
+    header.skipFromRoot = build.skipFromRoot;
+    header.tagsUsed = build.tagsUsed;
+    std::copy(build.classPageIndex.begin(), build.classPageIndex.end(), header.classPageIndex);
+
+    const void* sources[SectionCount] = {
+        build.classPages.data(), build.states.data(), build.transitionClasses.data(),
+        build.transitionTargets.data(), build.outputs.data(), build.dfaTransitions.data(),
+        build.patternLengths.data(), build.patternTags.data(), build.rootUnits.data()
+    };
+    const size_t counts[SectionCount] = {
+        build.classPages.size(), build.states.size(), build.transitionClasses.size(),
+        build.transitionTargets.size(), build.outputs.size(), build.dfaTransitions.size(),
+        build.patternLengths.size(), build.patternTags.size(), build.rootUnits.size()
+    };
+
+    qsizetype size = alignedSize(sizeof(BlobHeader));
+    for (int section = 0; section < SectionCount; ++section) {
+        header.sectionOffset[section] = size;
+        header.sectionCount[section] = counts[section];
+        size = alignedSize(size + counts[section] * sectionItemSizes[section]);
+    }
+
+    // quint64 storage keeps the blob 8-byte aligned
+    auto buffer = std::make_shared<std::vector<quint64>>(size / sizeof(quint64), 0);
+    char* data = reinterpret_cast<char*>(buffer->data());
+    std::memcpy(data, &header, sizeof(header));
+    for (int section = 0; section < SectionCount; ++section) {
+        if (counts[section] > 0) {
+            std::memcpy(data + header.sectionOffset[section], sources[section],
+                        counts[section] * sectionItemSizes[section]);
+        }
+    }
+
+    attach(std::move(buffer), data, size);
+}
+
+bool CompiledAhoCorasick::fromBlob(std::shared_ptr<const void> owner, const char* data, qsizetype size,
+                                   CompiledAhoCorasick& automaton) {
+    CompiledAhoCorasick loaded;
+    if (!loaded.attach(std::move(owner), data, size)) {
+        return false;
+    }
+    automaton = std::move(loaded);
+    return true;
+}
+
+QByteArray CompiledAhoCorasick::blob() const {
+    return QByteArray::fromRawData(blobData, blobSize);
+}
+
+/*
+Point the arrays into the blob at `data`.
+
+Checks the header, that every array and every index the search can
+follow stays inside the blob, and that the pattern lengths agree with the
+depths of the states reporting them, so a stale or damaged file is
+refused instead of read or written out of bounds. That is a few linear
+passes over the arrays, still far cheaper than building the automaton
+again.
+*/
+bool CompiledAhoCorasick::attach(std::shared_ptr<const void> owner, const char* data, qsizetype size) {
+    static_assert(sizeof(State) == 6 * sizeof(int), "State is stored as six ints");
+
+    if (!data || size < static_cast<qsizetype>(sizeof(BlobHeader))
+        || reinterpret_cast<quintptr>(data) % alignof(quint64) != 0) {
+        return false;
+    }
+
+    BlobHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != blobMagic || header.version != blobVersion
+        || header.byteOrder != blobByteOrder || header.mode > static_cast<quint32>(Mode::Dfa)
+        || header.classStride < 1 || header.classStride > 65536) {
+        return false;
+    }
+
+    for (int section = 0; section < SectionCount; ++section) {
+        quint64 offset = header.sectionOffset[section];
+        quint64 count = header.sectionCount[section];
+        if (offset % alignof(quint64) != 0 || offset > quint64(size)
+            || count > (quint64(size) - offset) / sectionItemSizes[section]) {
+            return false;
+        }
+    }
+
+    auto section = [&](int index, auto& array) {
+        using Item = std::remove_const_t<std::remove_pointer_t<decltype(array.items)>>;
+        array.items = reinterpret_cast<const Item*>(data + header.sectionOffset[index]);
+        array.count = static_cast<qsizetype>(header.sectionCount[index]);
+    };
+    Array<unsigned short> pages;
+    Array<State> stateArray;
+    Array<unsigned short> classes;
+    Array<int> targets;
+    Array<int> outputArray;
+    Array<int> dfaArray;
+    Array<int> lengths;
+    Array<quint8> tags;
+    Array<char16_t> rootUnits;
+    section(ClassPagesSection, pages);
+    section(StatesSection, stateArray);
+    section(TransitionClassesSection, classes);
+    section(TransitionTargetsSection, targets);
+    section(OutputsSection, outputArray);
+    section(DfaTransitionsSection, dfaArray);
+    section(PatternLengthsSection, lengths);
+    section(PatternTagsSection, tags);
+    section(RootUnitsSection, rootUnits);
+
+    Mode blobMode = static_cast<Mode>(header.mode);
+    qsizetype stateCount = stateArray.size();
+    if (pages.size() < 256 || pages.size() % 256 != 0 || stateCount < 1
+        || classes.size() != targets.size() || tags.size() != lengths.size()
+        || (blobMode == Mode::Dfa && dfaArray.size() != stateCount * header.classStride)) {
+        return false;
+    }
+    for (quint16 page : header.classPageIndex) {
+        if (page >= pages.size() / 256) {
+            return false;
+        }
+    }
+    for (unsigned short pageClass : pages) {
+        if (pageClass >= header.classStride) {
+            return false;
+        }
+    }
+    for (qsizetype s = 0; s < stateCount; ++s) {
+        const State& state = stateArray[s];
+        if (state.failLink < 0 || state.failLink >= stateCount
+            || state.outputLink < -1 || state.outputLink >= stateCount
+            || state.transitionBegin < 0 || state.transitionBegin > state.transitionEnd
+            || state.transitionEnd > classes.size()
+            || state.outputBegin < 0 || state.outputBegin > state.outputEnd
+            || state.outputEnd > outputArray.size()) {
+            return false;
+        }
+    }
+    for (int target : targets) {
+        if (target < 0 || target >= stateCount) {
+            return false;
+        }
+    }
+    for (int target : dfaArray) {
+        if (target < 0 || target >= stateCount) {
+            return false;
+        }
+    }
+
+    // The transitions form a trie numbered in BFS order: every state but the
+    // root is the child of exactly one earlier state, one unit deeper
+    std::vector<int> depths(stateCount, -1);
+    depths[0] = 0;
+    for (qsizetype s = 0; s < stateCount; ++s) {
+        if (depths[s] < 0) {
+            return false;
+        }
+        const State& state = stateArray[s];
+        for (int k = state.transitionBegin; k < state.transitionEnd; ++k) {
+            int target = targets[k];
+            if (target <= s || depths[target] >= 0) {
+                return false;
+            }
+            depths[target] = depths[s] + 1;
+        }
+    }
+
+    // Failure and output links point to shallower states and a Dfa step goes
+    // at most one unit deeper, so a state is never deeper than the units fed
+    // so far, and a search can't go round in circles
+    for (qsizetype s = 0; s < stateCount; ++s) {
+        const State& state = stateArray[s];
+        if ((s == 0 && state.failLink != 0) || (s > 0 && depths[state.failLink] >= depths[s])
+            || (state.outputLink >= 0 && depths[state.outputLink] >= depths[s])) {
+            return false;
+        }
+        if (blobMode == Mode::Dfa) {
+            const int* row = &dfaArray[s * header.classStride];
+            for (int c = 0; c < header.classStride; ++c) {
+                if (depths[row[c]] > depths[s] + 1) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    // A match starts patternLength - 1 units before its end, that has to be
+    // the depth of the state reporting it or redact() writes out of bounds
+    for (qsizetype s = 0; s < stateCount; ++s) {
+        const State& state = stateArray[s];
+        for (int k = state.outputBegin; k < state.outputEnd; ++k) {
+            int patternIndex = outputArray[k];
+            if (patternIndex < 0 || patternIndex >= lengths.size()
+                || depths[s] < 1 || lengths[patternIndex] != depths[s]) {
+                return false;
+            }
+        }
+    }
+    int longest = 0;
+    for (int length : lengths) {
+        if (length < 0) {
+            return false;
+        }
+        longest = std::max(longest, length);
+    }
+    if (header.longestPattern != longest) {
+        return false;
+    }
+    for (quint8 tag : tags) {
+        if (tag > 31) {
+            return false;
+        }
+    }
+
+    storage = std::move(owner);
+    blobData = data;
+    blobSize = size;
+    currentMode = blobMode;
+    longestPatternLength = header.longestPattern;
+    classStride = header.classStride;
+    std::copy(std::begin(header.classPageIndex), std::end(header.classPageIndex), classPageIndex.begin());
+    classPages = pages;
+    states = stateArray;
+    transitionClasses = classes;
+    transitionTargets = targets;
+    outputs = outputArray;
+    dfaTransitions = dfaArray;
+    patternLengths = lengths;
+    patternTags = tags;
+    tagsUsed = header.tagsUsed;
+    firstUnits = FirstUnitFilter(std::vector<char16_t>(rootUnits.begin(), rootUnits.end()));
+    skipFromRoot = header.skipFromRoot != 0;
+    return true;
+}
+
+bool CompiledAhoCorasick::isEmpty() const {
+    return states.size() <= 1;
+}
+
+CompiledAhoCorasick::Mode CompiledAhoCorasick::mode() const {
+    return currentMode;
+}
+
+int CompiledAhoCorasick::longestPattern() const {
+    return longestPatternLength;
+}
+
+int CompiledAhoCorasick::patternLength(int patternIndex) const {
+    if (patternIndex < 0 || patternIndex >= patternLengths.size()) {
+        return 0;
+    }
+    return patternLengths[patternIndex];
+}
+
+int CompiledAhoCorasick::patternTag(int patternIndex) const {
+    if (patternIndex < 0 || patternIndex >= patternTags.size()) {
+        return 0;
+    }
+    return patternTags[patternIndex];
+}
+
+bool CompiledAhoCorasick::usesTag(int tag) const {
+    return tag >= 0 && tag < 32 && (tagsUsed >> tag) & 1;
+}
+
+size_t CompiledAhoCorasick::bytesUsed() const {
+    return sizeof(*this) + blobSize + firstUnits.bytesUsed();
+}
+
+int CompiledAhoCorasick::nextState(int state, unsigned short currentClass) const {
+    while (true) {
+        const State& current = states[state];
+        auto first = transitionClasses.begin() + current.transitionBegin;
+        auto last = transitionClasses.begin() + current.transitionEnd;
+        auto it = std::lower_bound(first, last, currentClass);
+        if (it != last && *it == currentClass) {
+            return transitionTargets[it - transitionClasses.begin()];
+        }
+        if (state == 0) {
+            return 0;
+        }
+        state = current.failLink;
+    }
+}
+
+std::vector<std::pair<int, int>> CompiledAhoCorasick::search(QStringView text) const {
+    std::vector<std::pair<int, int>> result;
+    SearchState searchState;
+    scan(searchState, text, [&result](int patternIndex, qsizetype endPosition) {
+        result.push_back(std::make_pair(patternIndex, static_cast<int>(endPosition)));
+    });
+    return result;
+}
+
+/*
+Every chunk starts its scan longestPattern() - 1 units early from the root
+state and only keeps matches ending inside the chunk. A match is at most
+that long, so the lead-in is enough to find it, and since each end position
+belongs to exactly one chunk nothing is reported twice. Within a chunk the
+matches come out in the serial order, concatenating the chunks in text
+order gives exactly the list search() returns.
+*/
+std::vector<std::pair<int, int>> CompiledAhoCorasick::searchParallel(QStringView text) const {
+    int threads = QThreadPool::globalInstance()->maxThreadCount();
+    if (text.size() < minParallelUnits || threads < 2 || states.size() <= 1) {
+        return search(text);
+    }
+
+    struct Chunk {
+        qsizetype begin;
+        qsizetype end;
+        std::vector<std::pair<int, int>> matches;
+    };
+
+    // A few chunks per thread keeps the pool busy when chunks differ in cost
+    qsizetype chunkSize = std::max(minParallelUnits / 4, text.size() / (threads * 4) + 1);
+    std::vector<Chunk> chunks;
+    for (qsizetype begin = 0; begin < text.size(); begin += chunkSize) {
+        chunks.push_back(Chunk{begin, std::min(text.size(), begin + chunkSize), {}});
+    }
+
+    qsizetype leadIn = std::max(0, longestPatternLength - 1);
+    QtConcurrent::blockingMap(chunks, [this, text, leadIn](Chunk& chunk) {
+        SearchState searchState;
+        searchState.offset = std::max<qsizetype>(0, chunk.begin - leadIn);
+        QStringView window = text.mid(searchState.offset, chunk.end - searchState.offset);
+        scan(searchState, window, [&chunk](int patternIndex, qsizetype endPosition) {
+            if (endPosition >= chunk.begin) {
+                chunk.matches.push_back(std::make_pair(patternIndex, static_cast<int>(endPosition)));
+            }
+        });
+    });
+
+    std::vector<std::pair<int, int>> result;
+    size_t total = 0;
+    for (const Chunk& chunk : chunks) {
+        total += chunk.matches.size();
+    }
+    result.reserve(total);
+    for (const Chunk& chunk : chunks) {
+        result.insert(result.end(), chunk.matches.begin(), chunk.matches.end());
+    }
+    return result;
+}
+
+/*
+Matches come ordered by end position. The units masked so far form runs;
+only the last run [runStart, runEnd] matters, and a new match [start, end]
+never ends before it:
+
+- start past runEnd + 1: a new run, mask start..end
+- start inside the run: extend it, mask runEnd + 1..end
+- start before the run: a longer word covering the run, also mask
+  start..runStart - 1 (this may overwrite older runs in between, at most
+  longestPattern() units)
+
+So each unit is written once apart from that last case, and the output is
+the union of all matches: a unit is masked if any banned word covers it.
+Picking only leftmost-longest matches instead would leave the tails of
+overlapping words readable. Every word ending at a position is a suffix of
+the longest one ending there, so only that one is looked at and nested
+words cost nothing extra, as long as no words with other tags are mixed in.
+*/
+QString CompiledAhoCorasick::redact(const QString& text, int tag, QChar mask) const {
+    QString result = text;
+    QChar* out = nullptr;   // detached on the first match
+    qsizetype runStart = 0;
+    qsizetype runEnd = -1;
+
+    auto cover = [&](int patternIndex, qsizetype end) {
+        qsizetype start = end - patternLength(patternIndex) + 1;
+        if (!out) {
+            out = result.data();
+        }
+        if (start > runEnd + 1) {
+            runStart = start;
+        } else if (start < runStart) {
+            std::fill(out + start, out + runStart, mask);
+            runStart = start;
+        }
+        if (end > runEnd) {
+            std::fill(out + std::max(start, runEnd + 1), out + end + 1, mask);
+            runEnd = end;
+        }
+    };
+
+    if (!usesTag(tag)) {
+        return result;
+    }
+
+    // Words with other tags mixed in, the longest word may not be ours
+    bool otherTags = (tagsUsed & ~(1u << tag)) != 0;
+    auto coverTagged = [&](int patternIndex, qsizetype end) {
+        if (patternTags[patternIndex] == tag) {
+            cover(patternIndex, end);
+        }
+    };
+
+    // Whole documents (load, paste) are scanned on all cores
+    if (text.size() >= minParallelUnits) {
+        for (const auto& [patternIndex, end] : searchParallel(text)) {
+            coverTagged(patternIndex, end);
+        }
+    } else if (otherTags) {
+        SearchState searchState;
+        scan(searchState, QStringView(text), coverTagged);
+    } else {
+        SearchState searchState;
+        scanLongest(searchState, QStringView(text), cover);
+    }
+    return result;
+}
@@ -0,0 +1,276 @@
+#ifndef COMPILEDAHOCORASICK_H
+#define COMPILEDAHOCORASICK_H
+
+#include "ahocorasick.h"
+#include "firstunitfilter.h"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+#include <QByteArray>
+#include <QStringView>
+
+/*
+Read-only, flattened form of an AhoCorasick trie.
+
+The mutable trie is made for inserting and removing words, not for
+walking fast. This class copies the trie once into contiguous arrays:
+
+- every UTF-16 code unit is mapped to a small "unit class" (0 = not used by
+  any pattern) through a paged table, only pages holding pattern units are
+  stored
+- states are numbered in BFS order, root is state 0
+- transitions of a state are a sorted range in one shared array
+- outputs of a state are a range in one shared array, holding only the
+  words that end exactly there; outputLink points at the next state on the
+  failure chain that has outputs of its own
+
+Build it after AhoCorasick::buildFailureLinks() and search against it.
+
+All arrays live in one position independent blob (a header with the array
+offsets, then the arrays). blob() hands it out as it is and fromBlob()
+uses a blob in place, e.g. straight out of a mapped cache file, without
+copying or parsing it. The blob is only valid on machines with the same
+byte order, which fromBlob() checks.
+
+While the scan is in the root state it jumps straight to the next unit
+that can start a pattern (see FirstUnitFilter), so prose between matches
+costs a few vector instructions per 16 or 32 units instead of a transition
+per unit. Where the text is dense with such units the skip turns itself
+off, see scanSkipping().
+
+In Dfa mode the goto function is additionally resolved for every
+(state, unit class) pair, so a search step is one table lookup and never
+walks failure links. The table costs states * classes ints; when that goes
+over maxDfaBytes the automaton stays Sparse.
+
+Concurrency: the object never changes after construction, every public
+member is const and keeps its state on the caller's stack (or in the
+caller's SearchState), so any number of threads may search one instance
+at the same time. Only assigning a new automaton over it needs the
+readers to be done, share it through a std::shared_ptr<const ...> when
+that is a problem.
+*/
+class CompiledAhoCorasick {
+public:
+    enum class Mode {
+        Sparse, // sorted transition ranges + failure links
+        Dfa     // full transition table
+    };
+
+    static constexpr size_t maxDfaBytes = 64 * 1024 * 1024;
+    static constexpr qsizetype skipWindowUnits = 4096;
+    static constexpr qsizetype minParallelUnits = 256 * 1024;
+
+    // Where a streaming scan stopped, held by the caller between chunks
+    struct SearchState {
+        int state = 0;          // automaton state, 0 = root
+        qsizetype offset = 0;   // text position of the next unit to feed
+    };
+
+    CompiledAhoCorasick();
+    // `patternTags` maps pattern index -> tag (0 - 31), missing indexes get tag 0
+    explicit CompiledAhoCorasick(const AhoCorasick& trie, Mode mode = Mode::Sparse,
+                                 const std::vector<quint8>& patternTags = {});
+
+    // Use `size` bytes at `data` as the arrays, `owner` keeps them alive.
+    // Returns false, leaving `automaton` alone, if the blob does not fit.
+    static bool fromBlob(std::shared_ptr<const void> owner, const char* data, qsizetype size,
+                         CompiledAhoCorasick& automaton);
+    QByteArray blob() const; // no copy, valid as long as this automaton
+
+    bool isEmpty() const;
+    Mode mode() const;
+    size_t bytesUsed() const; // memory footprint of the compiled arrays
+    int longestPattern() const; // in code units
+    int patternLength(int patternIndex) const; // 0 for an unused index
+    int patternTag(int patternIndex) const;
+    bool usesTag(int tag) const;
+
+    // Same result format as AhoCorasick::search: (pattern index, end position)
+    std::vector<std::pair<int, int>> search(QStringView text) const;
+
+    // Same result as search(), the text is split into chunks that are scanned
+    // on the global thread pool. Falls back to search() for short texts.
+    std::vector<std::pair<int, int>> searchParallel(QStringView text) const;
+
+    // Copy of `text` with every unit covered by a word tagged `tag` replaced by
+    // `mask`, same length as `text`. Shares `text` when nothing matches.
+    QString redact(const QString& text, int tag = 0, QChar mask = QChar('*')) const;
+
+    // Feed `chunk` from `searchState` on and call visitor(patternIndex, endPosition)
+    // for every match, positions count from where the state started. No allocation.
+    template <typename Visitor>
+    void scan(SearchState& searchState, QStringView chunk, Visitor&& visitor) const;
+
+private:
+    struct State {
+        int failLink;
+        int outputLink;         // -1 = no shorter word ends here
+        int transitionBegin;
+        int transitionEnd;
+        int outputBegin;
+        int outputEnd;
+    };
+
+    // Read-only view of one array inside the blob
+    template <typename T>
+    struct Array {
+        const T* items = nullptr;
+        qsizetype count = 0;
+
+        const T& operator[](qsizetype i) const { return items[i]; }
+        const T* begin() const { return items; }
+        const T* end() const { return items + count; }
+        qsizetype size() const { return count; }
+        bool empty() const { return count == 0; }
+    };
+
+    struct Build;
+    void adopt(const Build& build);
+    bool attach(std::shared_ptr<const void> owner, const char* data, qsizetype size);
+
+    unsigned short unitClass(char16_t unit) const;
+    int nextState(int state, unsigned short currentClass) const;
+    int step(int state, char16_t unit) const;
+    template <bool SkipFromRoot, bool LongestOnly, typename Visitor>
+    int scanUnits(int state, const char16_t* text, qsizetype size,
+                  qsizetype base, Visitor& visitor, qsizetype& skipped) const;
+    template <bool LongestOnly, typename Visitor>
+    int scanSkipping(int state, const char16_t* text, qsizetype size,
+                     qsizetype base, Visitor& visitor) const;
+    // Like scan(), but only reports the longest word ending at each position
+    template <typename Visitor>
+    void scanLongest(SearchState& searchState, QStringView chunk, Visitor&& visitor) const;
+
+    std::shared_ptr<const void> storage;            // owns the blob, or the mapped file
+    const char* blobData;
+    qsizetype blobSize;
+
+    Mode currentMode;
+    int longestPatternLength;
+    int classStride;                                // unit classes incl. class 0
+    std::array<unsigned short, 256> classPageIndex; // high byte -> page, 0 = unused
+    Array<unsigned short> classPages;               // 256 classes per page
+    Array<State> states;
+    Array<unsigned short> transitionClasses;        // sorted within each state
+    Array<int> transitionTargets;
+    Array<int> outputs;
+    Array<int> dfaTransitions;                      // states * classStride, Dfa only
+    Array<int> patternLengths;                      // pattern index -> length
+    Array<quint8> patternTags;                      // pattern index -> tag
+    quint32 tagsUsed;                               // bit per tag with patterns
+    FirstUnitFilter firstUnits;                     // units with a root transition
+    bool skipFromRoot;                              // use firstUnits in scan()
+};
+
+inline unsigned short CompiledAhoCorasick::unitClass(char16_t unit) const {
+    return classPages[classPageIndex[unit >> 8] * 256 + (unit & 0xff)];
+}
+
+inline int CompiledAhoCorasick::step(int state, char16_t unit) const {
+    unsigned short currentClass = unitClass(unit);
+    if (currentMode == Mode::Dfa) {
+        return dfaTransitions[state * classStride + currentClass];
+    }
+    // A unit no pattern uses always falls back to the root
+    return currentClass ? nextState(state, currentClass) : 0;
+}
+
+template <bool SkipFromRoot, bool LongestOnly, typename Visitor>
+int CompiledAhoCorasick::scanUnits(int state, const char16_t* text, qsizetype size,
+                                   qsizetype base, Visitor& visitor, qsizetype& skipped) const {
+    for (qsizetype i = 0; i < size; ++i) {
+        // The root stays the root on any unit that starts no pattern
+        if (SkipFromRoot && state == 0 && !firstUnits.contains(text[i])) {
+            qsizetype next = firstUnits.find(text, i + 1, size);
+            skipped += next - i;
+            i = next;
+            if (i == size) {
+                break;
+            }
+        }
+        state = step(state, text[i]);
+        if (LongestOnly) {
+            // Every word of a state has the state's length, the deepest one wins
+            int s = states[state].outputBegin < states[state].outputEnd ? state : states[state].outputLink;
+            if (s >= 0) {
+                visitor(outputs[states[s].outputBegin], base + i);
+            }
+            continue;
+        }
+        for (int s = state; s >= 0; s = states[s].outputLink) {
+            const State& current = states[s];
+            for (int k = current.outputBegin; k < current.outputEnd; ++k) {
+                visitor(outputs[k], base + i);
+            }
+        }
+    }
+    return state;
+}
+
+/*
+Scan with the skip from the root in windows of skipWindowUnits. Where the
+text is full of units that start a pattern (prose against a list of
+common words) the skip hardly gets anywhere and the checks cost more than
+the steps it saves, so a window that skipped too little turns it off:
+less than half of its units in Sparse mode, less than three quarters in
+Dfa mode, where a step is a single lookup. Every 16th window tries again,
+the text may change.
+*/
+template <bool LongestOnly, typename Visitor>
+int CompiledAhoCorasick::scanSkipping(int state, const char16_t* text, qsizetype size,
+                                      qsizetype base, Visitor& visitor) const {
+    bool skipping = true;
+    int plainWindows = 0;
+    for (qsizetype done = 0; done < size; done += skipWindowUnits) {
+        qsizetype window = std::min(skipWindowUnits, size - done);
+        qsizetype skipped = 0;
+        if (skipping) {
+            state = scanUnits<true, LongestOnly>(state, text + done, window, base + done, visitor, skipped);
+            skipping = skipped * 4 >= window * (currentMode == Mode::Dfa ? 3 : 2);
+        } else {
+            state = scanUnits<false, LongestOnly>(state, text + done, window, base + done, visitor, skipped);
+            skipping = ++plainWindows % 16 == 0;
+        }
+    }
+    return state;
+}
+
+template <typename Visitor>
+void CompiledAhoCorasick::scan(SearchState& searchState, QStringView chunk, Visitor&& visitor) const {
+    qsizetype base = searchState.offset;
+    searchState.offset += chunk.size();
+    if (states.empty()) {
+        return;
+    }
+
+    // Separate loops, the skip check would slow down the plain one
+    const char16_t* text = reinterpret_cast<const char16_t*>(chunk.data());
+    if (skipFromRoot) {
+        searchState.state = scanSkipping<false>(searchState.state, text, chunk.size(), base, visitor);
+    } else {
+        qsizetype skipped = 0;
+        searchState.state = scanUnits<false, false>(searchState.state, text, chunk.size(), base, visitor, skipped);
+    }
+}
+
+template <typename Visitor>
+void CompiledAhoCorasick::scanLongest(SearchState& searchState, QStringView chunk, Visitor&& visitor) const {
+    qsizetype base = searchState.offset;
+    searchState.offset += chunk.size();
+    if (states.empty()) {
+        return;
+    }
+
+    const char16_t* text = reinterpret_cast<const char16_t*>(chunk.data());
+    if (skipFromRoot) {
+        searchState.state = scanSkipping<true>(searchState.state, text, chunk.size(), base, visitor);
+    } else {
+        qsizetype skipped = 0;
+        searchState.state = scanUnits<false, true>(searchState.state, text, chunk.size(), base, visitor, skipped);
+    }
+}
+
+#endif // COMPILEDAHOCORASICK_H
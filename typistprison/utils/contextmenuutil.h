@@ -23,6 +23,15 @@ public:
     // Static utility function that works with both QTextEdit and QPlainTextEdit
     template<typename TextEditType>
     static void showContextMenu(TextEditType* textEdit, const QPoint& pos) {
+        showContextMenu(textEdit, pos,
+                        textEdit->document()->isUndoAvailable(),
+                        textEdit->document()->isRedoAvailable());
+    }
+
+    // For editors keeping an undo history of their own (FictionTextEdit in
+    // paged mode), their undo() and redo() are called
+    template<typename TextEditType>
+    static void showContextMenu(TextEditType* textEdit, const QPoint& pos, bool hasUndo, bool hasRedo) {
         // Create the menu
         QMenu* menu = new QMenu(textEdit);
         menu->setAttribute(Qt::WA_TranslucentBackground);
@@ -66,9 +75,7 @@ public:
             return action;
         };
         
-        // Get document and cursor state (works for both QTextEdit and QPlainTextEdit)
-        bool hasUndo = textEdit->document()->isUndoAvailable();
-        bool hasRedo = textEdit->document()->isRedoAvailable();
+        // Get cursor state (works for both QTextEdit and QPlainTextEdit)
         bool hasSelection = textEdit->textCursor().hasSelection();
 
         #ifdef Q_OS_MAC
@@ -5,7 +5,7 @@
 #include <QColor>
 
 FictionHighlighter::FictionHighlighter(QTextDocument *parent)
-    : QSyntaxHighlighter(parent), searchString(""), globalFontSize(14)
+    : QSyntaxHighlighter(parent), globalFontSize(14), firstBlockIsTitle(true), searchString("")
 {
     // Define the format for search highlighting
     searchHighlightFormat.setBackground(QBrush(QColor("#4F726C"))); // Custom background color
@@ -48,13 +48,26 @@ void FictionHighlighter::setSearchString(const QString &searchString) {
     rehighlight(); // Trigger a rehighlight whenever the search string changes
 }
 
+void FictionHighlighter::setFirstBlockIsTitle(bool isTitle) {
+    firstBlockIsTitle = isTitle;
+}
+
 QString FictionHighlighter::getSearchString() const {
     return searchString;
 }
 
+void FictionHighlighter::setFlaggedSpanFinder(std::function<std::vector<FlaggedSpan>(QStringView)> finder) {
+    flaggedSpanFinder = std::move(finder);
+    rehighlight();
+}
+
 void FictionHighlighter::highlightBlock(const QString &text) {
     QTextBlock block = currentBlock();
     int lineNumber = block.blockNumber();
+    // the top of a later part of the manuscript is body text like the rest
+    if (lineNumber == 0 && !firstBlockIsTitle) {
+        lineNumber = 1;
+    }
 
     // Determine the format based on the line number
     if (lineNumber == 0) {
@@ -64,6 +77,20 @@ void FictionHighlighter::highlightBlock(const QString &text) {
         setFormat(0, text.length(), otherLineFormat);
     }
 
+    // Flagged words keep the line's font, the search highlight goes on top
+    if (flaggedSpanFinder) {
+        for (const FlaggedSpan& span : flaggedSpanFinder(text)) {
+            QTextCharFormat flaggedFormat = format(span.start);
+            if (span.warning) {
+                flaggedFormat.setUnderlineStyle(QTextCharFormat::WaveUnderline);
+                flaggedFormat.setUnderlineColor(QColor("#C8553D"));
+            } else {
+                flaggedFormat.setBackground(QBrush(QColor("#6B5B3E")));
+            }
+            setFormat(span.start, span.length, flaggedFormat);
+        }
+    }
+
     if (searchString.isEmpty()) {
         return;
     }
@@ -3,6 +3,15 @@
 
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
+#include <functional>
+#include <vector>
+
+// A span of a block to flag, e.g. a word from a warn or highlight list
+struct FlaggedSpan {
+    int start;
+    int length;
+    bool warning;   // wave underline, otherwise a background
+};
 
 class FictionHighlighter : public QSyntaxHighlighter {
     Q_OBJECT
@@ -15,12 +24,22 @@ public:
 
     void changeFontSize(int delta);
 
+    // Whether the document's first block is the manuscript's title (large).
+    // Not in the middle of a long manuscript, see FictionTextEdit's paged
+    // mode. Only blocks highlighted from then on see the change.
+    void setFirstBlockIsTitle(bool isTitle);
+
+    // Called with each block's text, an empty finder flags nothing
+    void setFlaggedSpanFinder(std::function<std::vector<FlaggedSpan>(QStringView)> finder);
+
 protected:
     void highlightBlock(const QString &text) override;
 
 private:
     int globalFontSize;
+    bool firstBlockIsTitle;
     QString searchString;
+    std::function<std::vector<FlaggedSpan>(QStringView)> flaggedSpanFinder;
 
     // Formats for highlighting and font sizes
     QTextCharFormat searchHighlightFormat;
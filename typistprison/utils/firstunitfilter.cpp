@@ -0,0 +1,180 @@
+#include "firstunitfilter.h"
+
+#include <algorithm>
+#include <QtAlgorithms>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define FIRSTUNITFILTER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+#ifdef FIRSTUNITFILTER_X86
+// 16 units per step, only called after checking the CPU
+__attribute__((target("ssse3")))
+qsizetype findSsse3(const FirstUnitFilter& filter, const quint8* tables,
+                    const char16_t* text, qsizetype from, qsizetype size) {
+    const __m128i nibble0 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables));
+    const __m128i nibble1 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables + 16));
+    const __m128i nibble2 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables + 32));
+    const __m128i nibble3 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables + 48));
+    const __m128i lowNibble = _mm_set1_epi8(0x0f);
+    const __m128i lowByte = _mm_set1_epi16(0x00ff);
+
+    qsizetype i = from;
+    for (; i + 16 <= size; i += 16) {
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i + 8));
+        // Low and high bytes of the 16 units, one byte per unit
+        __m128i low = _mm_packus_epi16(_mm_and_si128(first, lowByte), _mm_and_si128(second, lowByte));
+        __m128i high = _mm_packus_epi16(_mm_srli_epi16(first, 8), _mm_srli_epi16(second, 8));
+
+        __m128i buckets = _mm_and_si128(
+            _mm_shuffle_epi8(nibble0, _mm_and_si128(low, lowNibble)),
+            _mm_shuffle_epi8(nibble1, _mm_and_si128(_mm_srli_epi16(low, 4), lowNibble)));
+        buckets = _mm_and_si128(buckets, _mm_shuffle_epi8(nibble2, _mm_and_si128(high, lowNibble)));
+        buckets = _mm_and_si128(
+            buckets, _mm_shuffle_epi8(nibble3, _mm_and_si128(_mm_srli_epi16(high, 4), lowNibble)));
+
+        quint32 candidates = ~static_cast<quint32>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(buckets, _mm_setzero_si128()))) & 0xffff;
+        for (; candidates; candidates &= candidates - 1) {
+            qsizetype at = i + qCountTrailingZeroBits(candidates);
+            if (filter.contains(text[at])) {
+                return at;
+            }
+        }
+    }
+    return i;
+}
+
+// 32 units per step, only called after checking the CPU
+__attribute__((target("avx2")))
+qsizetype findAvx2(const FirstUnitFilter& filter, const quint8* tables,
+                   const char16_t* text, qsizetype from, qsizetype size) {
+    const __m256i nibble0 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables)));
+    const __m256i nibble1 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables + 16)));
+    const __m256i nibble2 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables + 32)));
+    const __m256i nibble3 = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(tables + 48)));
+    const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+    const __m256i lowByte = _mm256_set1_epi16(0x00ff);
+
+    qsizetype i = from;
+    for (; i + 32 <= size; i += 32) {
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(text + i + 16));
+        // Packing works per 128-bit lane, put the units back in text order
+        __m256i low = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(_mm256_and_si256(first, lowByte), _mm256_and_si256(second, lowByte)),
+            _MM_SHUFFLE(3, 1, 2, 0));
+        __m256i high = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(_mm256_srli_epi16(first, 8), _mm256_srli_epi16(second, 8)),
+            _MM_SHUFFLE(3, 1, 2, 0));
+
+        __m256i buckets = _mm256_and_si256(
+            _mm256_shuffle_epi8(nibble0, _mm256_and_si256(low, lowNibble)),
+            _mm256_shuffle_epi8(nibble1, _mm256_and_si256(_mm256_srli_epi16(low, 4), lowNibble)));
+        buckets = _mm256_and_si256(buckets, _mm256_shuffle_epi8(nibble2, _mm256_and_si256(high, lowNibble)));
+        buckets = _mm256_and_si256(
+            buckets, _mm256_shuffle_epi8(nibble3, _mm256_and_si256(_mm256_srli_epi16(high, 4), lowNibble)));
+
+        quint32 candidates = ~static_cast<quint32>(
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(buckets, _mm256_setzero_si256())));
+        for (; candidates; candidates &= candidates - 1) {
+            qsizetype at = i + qCountTrailingZeroBits(candidates);
+            if (filter.contains(text[at])) {
+                return at;
+            }
+        }
+    }
+    return i;
+}
+
+bool hasSsse3() {
+    static const bool supported = __builtin_cpu_supports("ssse3");
+    return supported;
+}
+
+bool hasAvx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+}
+
+FirstUnitFilter::FirstUnitFilter()
+    : nibbleBuckets{}
+    , count(0) {
+}
+
+FirstUnitFilter::FirstUnitFilter(const std::vector<char16_t>& firstUnits)
+    : nibbleBuckets{}
+    , count(0) {
+    if (firstUnits.empty()) {
+        return;
+    }
+
+    bitmap.assign(65536 / 64, 0);
+    for (char16_t unit : firstUnits) {
+        bitmap[unit >> 6] |= quint64(1) << (unit & 63);
+    }
+
+    std::vector<char16_t> units = firstUnits;
+    std::sort(units.begin(), units.end());
+    units.erase(std::unique(units.begin(), units.end()), units.end());
+    count = static_cast<int>(units.size());
+
+    // Neighbouring units share their high nibbles, give each bucket a run of
+    // the sorted set so their combinations let few other units through
+    for (int k = 0; k < count; ++k) {
+        quint8 bucket = quint8(1) << (static_cast<qint64>(k) * bucketCount / count);
+        for (int place = 0; place < 4; ++place) {
+            nibbleBuckets[place * 16 + ((units[k] >> (4 * place)) & 0x0f)] |= bucket;
+        }
+    }
+}
+
+bool FirstUnitFilter::vectorized() {
+#ifdef FIRSTUNITFILTER_X86
+    return hasSsse3();
+#else
+    return false;
+#endif
+}
+
+size_t FirstUnitFilter::bytesUsed() const {
+    return bitmap.capacity() * sizeof(quint64);
+}
+
+qsizetype FirstUnitFilter::findScalar(const char16_t* text, qsizetype from, qsizetype size) const {
+    for (qsizetype i = from; i < size; ++i) {
+        if (contains(text[i])) {
+            return i;
+        }
+    }
+    return size;
+}
+
+qsizetype FirstUnitFilter::find(const char16_t* text, qsizetype from, qsizetype size) const {
+    if (bitmap.empty()) {
+        return size;
+    }
+
+    qsizetype i = from;
+#ifdef FIRSTUNITFILTER_X86
+    if (hasAvx2()) {
+        i = findAvx2(*this, nibbleBuckets.data(), text, i, size);
+        if (i + 32 <= size) {
+            return i;
+        }
+    }
+    if (hasSsse3()) {
+        i = findSsse3(*this, nibbleBuckets.data(), text, i, size);
+        if (i + 16 <= size) {
+            return i;
+        }
+    }
+#endif
+    // Tail shorter than a vector, or no SSSE3
+    return findScalar(text, i, size);
+}
@@ -0,0 +1,58 @@
+#ifndef FIRSTUNITFILTER_H
+#define FIRSTUNITFILTER_H
+
+#include <array>
+#include <vector>
+#include <QtGlobal>
+
+/*
+Set of the UTF-16 code units that can start a pattern.
+
+While the automaton sits in its root state, every unit outside this set
+leads back to the root without a match, so whole runs of such units can
+be skipped. contains() tests a 64K bitmap.
+
+find() screens 16 (SSSE3) or 32 (AVX2) units per step with nibble tables,
+picked at runtime by CPU support. The set is spread over 8 buckets, and for
+each of the four nibbles of a unit a table holds the buckets that have a
+unit with that nibble in that place. A unit whose four lookups (pshufb)
+share a bucket is a candidate, confirmed against the bitmap. That works for
+sets of any size: up to 8 units there is one per bucket and no false
+candidate, larger sets let some units outside the set through, which the
+bitmap then drops. Without SSSE3, and on other CPUs, find() tests the
+bitmap one unit at a time.
+*/
+class FirstUnitFilter {
+public:
+    static constexpr int bucketCount = 8;
+
+    FirstUnitFilter();
+    explicit FirstUnitFilter(const std::vector<char16_t>& units);
+
+    bool contains(char16_t unit) const;
+    int unitCount() const;
+    static bool vectorized(); // find() screens units with nibble tables on this CPU
+
+    // Position of the first unit in [from, size) that is in the set, size if none
+    qsizetype find(const char16_t* text, qsizetype from, qsizetype size) const;
+
+    size_t bytesUsed() const;
+
+private:
+    qsizetype findScalar(const char16_t* text, qsizetype from, qsizetype size) const;
+
+    std::vector<quint64> bitmap;    // 65536 bits, empty while the set is empty
+    // 16 bucket masks per nibble of a unit, lowest nibble first
+    alignas(16) std::array<quint8, 4 * 16> nibbleBuckets;
+    int count;
+};
+
+inline bool FirstUnitFilter::contains(char16_t unit) const {
+    return !bitmap.empty() && (bitmap[unit >> 6] >> (unit & 63)) & 1;
+}
+
+inline int FirstUnitFilter::unitCount() const {
+    return count;
+}
+
+#endif // FIRSTUNITFILTER_H
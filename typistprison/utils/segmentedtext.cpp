@@ -0,0 +1,209 @@
+#include "segmentedtext.h"
+
+#include <QStringView>
+#include <algorithm>
+
+namespace {
+// Height per QChar before anything was measured, about one 14pt line per 80 characters
+const qreal defaultUnitHeight = 0.25;
+}
+
+SegmentedText::SegmentedText(const QString &text) {
+    replace(0, 0, text);
+}
+
+int SegmentedText::count() const {
+    return static_cast<int>(segments.size());
+}
+
+const QString &SegmentedText::text(int segment) const {
+    return segments[segment].text;
+}
+
+qsizetype SegmentedText::start(int segment) const {
+    qsizetype position = 0;
+    for (int i = 0; i < segment; ++i) {
+        position += segments[i].text.size() + 1;
+    }
+    return position;
+}
+
+int SegmentedText::segmentAt(qsizetype position) const {
+    qsizetype segmentStart = 0;
+    for (int i = 0; i < count() - 1; ++i) {
+        qsizetype segmentEnd = segmentStart + segments[i].text.size();
+        if (position <= segmentEnd) {
+            return i;
+        }
+        segmentStart = segmentEnd + 1;
+    }
+    return count() - 1;
+}
+
+QString SegmentedText::joined(int first, int last) const {
+    qsizetype size = 0;
+    for (int i = first; i < last; ++i) {
+        size += segments[i].text.size() + (i > first ? 1 : 0);
+    }
+    QString result;
+    result.reserve(size);
+    for (int i = first; i < last; ++i) {
+        if (i > first) {
+            result += QLatin1Char('\n');
+        }
+        result += segments[i].text;
+    }
+    return result;
+}
+
+QString SegmentedText::toPlainText() const {
+    return joined(0, count());
+}
+
+int SegmentedText::replace(int first, int last, const QString &text) {
+    std::vector<QString> pieces = split(text);
+    std::vector<Segment> replacement(pieces.size());
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        replacement[i].text = std::move(pieces[i]);
+    }
+    segments.erase(segments.begin() + first, segments.begin() + last);
+    segments.insert(segments.begin() + first, replacement.begin(), replacement.end());
+    return static_cast<int>(replacement.size());
+}
+
+/*
+Cut before a line break at least targetUnits into the segment. A blank line
+(two line breaks in a row) between half and twice that is taken instead,
+so segments tend to end where the manuscript has a scene or chapter break.
+Both searches only look at a bounded stretch, so text without blank lines
+or with very long paragraphs still splits in linear time.
+*/
+std::vector<QString> SegmentedText::split(const QString &text) {
+    std::vector<QString> pieces;
+    QStringView view(text);
+    qsizetype begin = 0;
+    while (true) {
+        qsizetype end = -1;
+        if (text.size() - begin > targetUnits) {
+            qsizetype from = begin + targetUnits / 2;
+            qsizetype length = std::min<qsizetype>(2 * targetUnits - targetUnits / 2, text.size() - from);
+            qsizetype blank = view.mid(from, length).indexOf(u"\n\n");
+            if (blank >= 0) {
+                end = from + blank;
+            } else {
+                end = text.indexOf(QLatin1Char('\n'), begin + targetUnits);
+            }
+        }
+        if (end < 0) {
+            pieces.push_back(text.mid(begin));
+            break;
+        }
+        pieces.push_back(text.mid(begin, end - begin));
+        begin = end + 1;
+    }
+    return pieces;
+}
+
+qreal SegmentedText::unitHeight() const {
+    qreal height = 0;
+    qsizetype units = 0;
+    for (const Segment &segment : segments) {
+        if (segment.height >= 0) {
+            height += segment.height;
+            units += segment.text.size();
+        }
+    }
+    return units > 0 ? height / units : defaultUnitHeight;
+}
+
+qreal SegmentedText::height(int segment) const {
+    const Segment &entry = segments[segment];
+    return entry.height >= 0 ? entry.height : entry.text.size() * unitHeight();
+}
+
+qreal SegmentedText::heightBefore(int segment) const {
+    qreal perUnit = unitHeight();
+    qreal height = 0;
+    for (int i = 0; i < segment; ++i) {
+        height += segments[i].height >= 0 ? segments[i].height : segments[i].text.size() * perUnit;
+    }
+    return height;
+}
+
+int SegmentedText::segmentAtHeight(qreal y) const {
+    qreal perUnit = unitHeight();
+    qreal top = 0;
+    for (int i = 0; i < count() - 1; ++i) {
+        top += segments[i].height >= 0 ? segments[i].height : segments[i].text.size() * perUnit;
+        if (y < top) {
+            return i;
+        }
+    }
+    return count() - 1;
+}
+
+void SegmentedText::setHeight(int segment, qreal height) {
+    segments[segment].height = height;
+}
+
+void SegmentedText::clearHeights() {
+    for (Segment &segment : segments) {
+        segment.height = -1;
+    }
+}
+
+qsizetype SegmentedText::indexOf(const QString &needle, qsizetype from, Qt::CaseSensitivity cs) const {
+    from = std::max<qsizetype>(from, 0);
+    int segment = segmentAt(from);
+    qsizetype segmentStart = start(segment);
+    for (; segment < count(); ++segment) {
+        const QString &text = segments[segment].text;
+        qsizetype index = text.indexOf(needle, std::max<qsizetype>(from - segmentStart, 0), cs);
+        if (index >= 0) {
+            return segmentStart + index;
+        }
+        segmentStart += text.size() + 1;
+    }
+    return -1;
+}
+
+/*
+Like QString::lastIndexOf(): a match starts at `from` or before, a negative
+`from` counts from the end of the whole text.
+*/
+qsizetype SegmentedText::lastIndexOf(const QString &needle, qsizetype from, Qt::CaseSensitivity cs) const {
+    int last = count() - 1;
+    if (from < 0) {
+        from += start(last) + segments[last].text.size();
+        if (from < 0) {
+            return -1;
+        }
+    }
+    int segment = segmentAt(from);
+    qsizetype segmentStart = start(segment);
+    for (; segment >= 0; --segment) {
+        const QString &text = segments[segment].text;
+        if (!text.isEmpty()) {
+            qsizetype index = text.lastIndexOf(needle, std::min<qsizetype>(from - segmentStart, text.size() - 1), cs);
+            if (index >= 0) {
+                return segmentStart + index;
+            }
+        }
+        if (segment > 0) {
+            segmentStart -= segments[segment - 1].text.size() + 1;
+        }
+    }
+    return -1;
+}
+
+int SegmentedText::countWords(const std::function<int(const QString &)> &counter, int first, int last) {
+    int words = 0;
+    for (int i = first; i < last; ++i) {
+        Segment &segment = segments[i];
+        if (segment.words < 0) {
+            segment.words = counter(segment.text);
+        }
+        words += segment.words;
+    }
+    return words;
+}
@@ -0,0 +1,68 @@
+#ifndef SEGMENTEDTEXT_H
+#define SEGMENTEDTEXT_H
+
+#include <QString>
+#include <functional>
+#include <vector>
+
+/*
+A long manuscript cut into segments of whole paragraphs, for editing it a
+few segments at a time (see FictionTextEdit's paged mode).
+
+Segments end at a line break, preferably one starting a run of blank
+lines, once they reach targetUnits; a paragraph is never cut. Joining all
+segments with "\n" gives back the text exactly, so positions in the whole
+text are the segment's start() plus the position in the segment.
+
+Every segment also has a height on screen: measured by the owner while the
+segment is laid out, otherwise estimated from its length and the height
+per QChar of the measured ones. Word counts are cached per segment until
+the segment is replaced.
+*/
+class SegmentedText
+{
+public:
+    static constexpr qsizetype targetUnits = 32 * 1024;
+
+    explicit SegmentedText(const QString &text = QString());
+
+    int count() const;
+    const QString &text(int segment) const;
+    qsizetype start(int segment) const;             // position in the whole text
+    int segmentAt(qsizetype position) const;        // segment holding `position`
+    QString joined(int first, int last) const;      // segments first..last-1, as in the whole text
+    QString toPlainText() const;
+
+    // Cut `text` into segments in place of first..last-1, returns how many
+    int replace(int first, int last, const QString &text);
+
+    qreal height(int segment) const;
+    qreal heightBefore(int segment) const;          // of all segments before `segment`
+    int segmentAtHeight(qreal y) const;             // segment covering `y`, from the top
+    void setHeight(int segment, qreal height);      // measured
+    void clearHeights();                            // layout changed, back to estimates
+
+    // Case-insensitive or not, positions in the whole text, -1 if not found.
+    // Needles never span segments, they hold no line break.
+    qsizetype indexOf(const QString &needle, qsizetype from, Qt::CaseSensitivity cs) const;
+    qsizetype lastIndexOf(const QString &needle, qsizetype from, Qt::CaseSensitivity cs) const;
+
+    // Sum of counter(text) over segments first..last-1, cached per segment,
+    // so `counter` has to stay the same function
+    int countWords(const std::function<int(const QString &)> &counter, int first, int last);
+
+    static std::vector<QString> split(const QString &text);
+
+private:
+    struct Segment {
+        QString text;
+        qreal height = -1;  // -1 = not measured
+        int words = -1;     // -1 = not counted
+    };
+
+    qreal unitHeight() const;
+
+    std::vector<Segment> segments;
+};
+
+#endif // SEGMENTEDTEXT_H
@@ -0,0 +1,96 @@
+#include "wikiblockdata.h"
+
+#include <algorithm>
+
+/*
+The tree is implicit in the sorted array: index i sits at the level given
+by its number of trailing one bits, leaves at even indexes, and the root at
+2^maxLevel - 1. Nodes past the end of the array are missing, their subtree
+maximum is taken from the last real node.
+*/
+WikiBlockData::WikiBlockData(std::vector<Span> spanList, int wikiGeneration)
+    : spans(std::move(spanList))
+    , maxLevel(0)
+    , generation(wikiGeneration)
+{
+    std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) {
+        return a.start < b.start;
+    });
+
+    int n = static_cast<int>(spans.size());
+    maxEnd.resize(n);
+    if (n == 0) {
+        return;
+    }
+
+    int lastIndex = 0;
+    int last = 0;
+    for (int i = 0; i < n; i += 2) {
+        lastIndex = i;
+        maxEnd[i] = last = spans[i].end;
+    }
+    int k = 1;
+    for (; (1 << k) <= n; ++k) {
+        int x = 1 << (k - 1);
+        for (int i = (x << 1) - 1; i < n; i += x << 2) {
+            int leftEnd = maxEnd[i - x];
+            int rightEnd = i + x < n ? maxEnd[i + x] : last;
+            maxEnd[i] = std::max({spans[i].end, leftEnd, rightEnd});
+        }
+        lastIndex = (lastIndex >> k & 1) ? lastIndex - x : lastIndex + x;
+        if (lastIndex < n && maxEnd[lastIndex] > last) {
+            last = maxEnd[lastIndex];
+        }
+    }
+    maxLevel = k - 1;
+}
+
+int WikiBlockData::wikiGeneration() const {
+    return generation;
+}
+
+WikiBlockData::Span& WikiBlockData::span(int index) {
+    return spans[index];
+}
+
+void WikiBlockData::overlapping(int from, int to, std::vector<int>& result) const {
+    int n = static_cast<int>(spans.size());
+    if (n == 0) {
+        return;
+    }
+
+    struct Node {
+        int level;
+        int index;
+        bool leftDone;
+    };
+    Node stack[64];
+    int top = 0;
+    stack[top++] = {maxLevel, (1 << maxLevel) - 1, false};
+
+    while (top > 0) {
+        Node node = stack[--top];
+        if (node.level <= 3) {
+            // Small subtree, scan it
+            int first = node.index >> node.level << node.level;
+            int last = std::min(first + (1 << (node.level + 1)) - 1, n);
+            for (int i = first; i < last && spans[i].start < to; ++i) {
+                if (from < spans[i].end) {
+                    result.push_back(i);
+                }
+            }
+        } else if (!node.leftDone) {
+            // Left subtree first, unless nothing in it reaches `from`
+            int left = node.index - (1 << (node.level - 1));
+            stack[top++] = {node.level, node.index, true};
+            if (left >= n || maxEnd[left] > from) {
+                stack[top++] = {node.level - 1, left, false};
+            }
+        } else if (node.index < n && spans[node.index].start < to) {
+            if (from < spans[node.index].end) {
+                result.push_back(node.index);
+            }
+            stack[top++] = {node.level - 1, node.index + (1 << (node.level - 1)), false};
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef WIKIBLOCKDATA_H
+#define WIKIBLOCKDATA_H
+
+#include <QRectF>
+#include <QString>
+#include <QTextBlockUserData>
+#include <QVector>
+#include <vector>
+
+/*
+Wiki matches of one paragraph, kept as the block's user data so hovering
+does not search the paragraph again.
+
+The owner computes the spans when the paragraph is first hovered after it
+changed, and drops the data when the paragraph's text changes. Spans are
+indexed by an implicit interval tree over their sorted starts, so looking
+up the spans under the mouse takes O(log n + hits) whatever the paragraph
+length. Each span also caches its line rectangles, relative to the block,
+for one layout generation of the owner.
+*/
+class WikiBlockData : public QTextBlockUserData
+{
+public:
+    struct Span {
+        int start;              // in the block's text
+        int end;                // one past the last QChar
+        QString key;            // wiki title
+        QVector<QRectF> rects;  // one per line, relative to the block's top left
+        int rectsGeneration = -1;
+    };
+
+    WikiBlockData(std::vector<Span> spans, int wikiGeneration);
+
+    int wikiGeneration() const;
+    Span& span(int index);
+
+    // Append the index of every span overlapping [from, to) to `result`
+    void overlapping(int from, int to, std::vector<int>& result) const;
+
+private:
+    std::vector<Span> spans;        // sorted by start
+    std::vector<int> maxEnd;        // largest end in each node's subtree
+    int maxLevel;
+    int generation;
+};
+
+#endif // WIKIBLOCKDATA_H
@@ -0,0 +1,155 @@
+#include "wikisource.h"
+
+#include <QFile>
+#include <cstring>
+
+namespace {
+bool isSpace(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\f' || ch == '\v';
+}
+
+/*
+Same as matching `^(#{1,6})\s+(.+)$` against the line, for ASCII white
+space. `level` is 0 - 5, `title` may come out empty when only white space
+follows the hash marks.
+*/
+bool parseHeading(const char* line, qint64 length, int& level, QString& title) {
+    qint64 hashes = 0;
+    while (hashes < length && hashes < 7 && line[hashes] == '#') {
+        ++hashes;
+    }
+    if (hashes == 0 || hashes == 7 || hashes + 2 > length || !isSpace(line[hashes])) {
+        return false;
+    }
+    level = static_cast<int>(hashes) - 1;
+    title = QString::fromUtf8(line + hashes + 1, static_cast<int>(length - hashes - 1)).trimmed();
+    return true;
+}
+
+// Same as line.trimmed().startsWith("```")
+bool isFence(const char* line, qint64 length) {
+    qint64 i = 0;
+    while (i < length && isSpace(line[i])) {
+        ++i;
+    }
+    return length - i >= 3 && std::memcmp(line + i, "```", 3) == 0;
+}
+}
+
+std::shared_ptr<const WikiSource> WikiSource::open(const QString& path, const WikiSource* previous) {
+    QByteArray contents;
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return nullptr;
+        }
+        contents = file.readAll();
+    }
+
+    auto source = std::make_shared<WikiSource>();
+    source->filePath = path;
+    source->fingerprint = AutomatonCache::fingerprint(path, contents);
+    // Sections index the bytes read, not whatever the file has grown to since
+    source->fingerprint.size = contents.size();
+
+    if (previous && previous->fingerprint.hash == source->fingerprint.hash) {
+        source->sectionList = previous->sectionList;
+    } else {
+        source->sectionList = parse(contents.constData(), contents.size());
+    }
+    return source;
+}
+
+std::shared_ptr<const WikiSource> WikiSource::open(const QString& path, const SourceFingerprint& source,
+                                                   std::vector<WikiSection> sections) {
+    if (!AutomatonCache::statFingerprint(path).sameStat(source)) {
+        return nullptr;
+    }
+    // Don't trust the ranges blindly, text() reads them
+    for (size_t i = 0; i < sections.size(); ++i) {
+        const WikiSection& section = sections[i];
+        if (section.begin < 0 || section.begin > section.end || section.end > source.size
+            || section.level < 0 || section.level > 5
+            || section.parent < -1 || section.parent >= static_cast<int>(i)) {
+            return nullptr;
+        }
+    }
+    auto indexed = std::make_shared<WikiSource>();
+    indexed->filePath = path;
+    indexed->fingerprint = source;
+    indexed->sectionList = std::move(sections);
+    return indexed;
+}
+
+/*
+Index the headings of a markdown text. Lines inside ``` blocks are never
+headings. A heading closes every open section of its level or deeper and
+opens one of its own, unless its title is empty.
+
+returns: std::vector<WikiSection>
+    sections in the order their headings appear
+*/
+std::vector<WikiSection> WikiSource::parse(const char* data, qint64 size) {
+    std::vector<WikiSection> sections;
+    int openSections[6] = {-1, -1, -1, -1, -1, -1}; // section index per level
+    bool isCodeBlock = false;
+
+    qint64 lineBegin = 0;
+    if (size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        lineBegin = 3; // byte order mark
+    }
+
+    while (lineBegin < size) {
+        const char* newline = static_cast<const char*>(std::memchr(data + lineBegin, '\n', size - lineBegin));
+        qint64 lineEnd = newline ? newline - data : size;
+        const char* line = data + lineBegin;
+        qint64 length = lineEnd - lineBegin;
+
+        int level;
+        QString title;
+        if (isFence(line, length)) {
+            isCodeBlock = !isCodeBlock;
+        } else if (!isCodeBlock && parseHeading(line, length, level, title)) {
+            // Equal or more hash marks end here
+            for (int j = level; j < 6; ++j) {
+                if (openSections[j] >= 0) {
+                    sections[openSections[j]].end = lineBegin;
+                    openSections[j] = -1;
+                }
+            }
+            if (!title.isEmpty()) {
+                int parent = -1;
+                for (int j = level - 1; j >= 0 && parent < 0; --j) {
+                    parent = openSections[j];
+                }
+                openSections[level] = static_cast<int>(sections.size());
+                sections.push_back({title, lineBegin, size, level, parent});
+            }
+        }
+        lineBegin = lineEnd + 1;
+    }
+    return sections;
+}
+
+const QString& WikiSource::path() const {
+    return filePath;
+}
+
+const SourceFingerprint& WikiSource::source() const {
+    return fingerprint;
+}
+
+const std::vector<WikiSection>& WikiSource::sections() const {
+    return sectionList;
+}
+
+QString WikiSource::text(const WikiSection& section) const {
+    QByteArray bytes;
+    QFile file(filePath);
+    if (file.open(QIODevice::ReadOnly) && file.seek(section.begin)) {
+        bytes = file.read(section.end - section.begin);
+    }
+    QString content = QString::fromUtf8(bytes);
+    content.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+    return content.trimmed();
+}
@@ -0,0 +1,59 @@
+#ifndef WIKISOURCE_H
+#define WIKISOURCE_H
+
+#include "automatoncache.h"
+
+#include <QString>
+#include <memory>
+#include <vector>
+
+/*
+A markdown heading and what belongs to it: from the heading line up to the
+next heading of the same or a higher level, sub-sections included.
+*/
+struct WikiSection {
+    QString title;
+    qint64 begin;       // byte range in the file, heading line included
+    qint64 end;
+    int level;          // 0 - 5 for # - ######
+    int parent;         // enclosing section in the same file, -1 at the top
+};
+
+/*
+One wiki file with the index of its sections.
+
+Only the titles are copied out of the file; section text is read from the
+file when asked for, so memory grows with the number of headings and not
+with how deeply they nest. The file is only open while it is indexed and
+while text() reads a section, never in between: a wiki of thousands of
+pages holds no descriptors, and the app can save over a page (Windows
+refuses to rewrite a file that is mapped or open elsewhere).
+
+If the file changed since it was indexed, text() reads the old range of
+the new contents, which at worst is stale text until the next rebuild.
+*/
+class WikiSource
+{
+public:
+    // Read and index `path`, nullptr if it cannot be read. Sections are taken
+    // over from `previous` when the contents have not changed.
+    static std::shared_ptr<const WikiSource> open(const QString& path,
+                                                  const WikiSource* previous = nullptr);
+    // `path` with a known index, e.g. from a cache, without reading it. Returns
+    // nullptr unless the file still has the size and time of `source`.
+    static std::shared_ptr<const WikiSource> open(const QString& path, const SourceFingerprint& source,
+                                                  std::vector<WikiSection> sections);
+    static std::vector<WikiSection> parse(const char* data, qint64 size);
+
+    const QString& path() const;
+    const SourceFingerprint& source() const;
+    const std::vector<WikiSection>& sections() const;
+    QString text(const WikiSection& section) const; // trimmed, "\r\n" as "\n"
+
+private:
+    QString filePath;
+    SourceFingerprint fingerprint;
+    std::vector<WikiSection> sectionList;
+};
+
+#endif // WIKISOURCE_H